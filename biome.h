@@ -0,0 +1,192 @@
+// biome.h
+// Biome maps from multi-channel noise and a quantized lookup table
+// Built on noise.h (SquirrelNoise5) and valuenoise.h (fBm grids)
+
+#ifndef _BIOME_H
+#define _BIOME_H
+
+#include "noise.h"
+#include "valuenoise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Biomes
+//
+// A biome table maps quantized climate channels (temperature, moisture
+//  and, for 3D tables, height) to a biome ID in 0..255.  Each channel in
+//  [-1,1] is cut into BIOME_LEVELS bins, so the table has BIOME_LEVELS^2 or
+//  BIOME_LEVELS^3 entries.  Tables are compiled once, either from a list of
+//  range rules or from a classifier function evaluated at each bin center;
+//  after that, classifying a cell is a few multiplies and a buffer index,
+//  with no per-cell branching on the floats.
+//
+// BiomeMap generates every channel for a region with Get2dFbmGrid (each
+//  channel on its own seed derived from the map seed) and emits one byte
+//  per cell, row-major.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define BIOME_LEVELS            32      // Bins per channel
+
+#define BIOME_TEMPERATURE       0
+#define BIOME_MOISTURE          1
+#define BIOME_HEIGHT            2
+
+// Indices into a compiled table
+#define BIOME_TABLE_DIMS        0       // 2 or 3 channels
+#define BIOME_TABLE_DATA        1       // buffer of biome IDs
+
+//--------------------------------------------------------------------------
+// Compile a table.  Rules are ({ biome, tMin, tMax, mMin, mMax }) for 2D
+//  tables and ({ biome, tMin, tMax, mMin, mMax, hMin, hMax }) for 3D; the
+//  first rule whose ranges contain the bin center wins, otherwise
+//  defaultBiome.  A classifier is called as classify( t, m, h ) (h is 0.0
+//  for 2D tables) and returns the biome ID.
+//
+mixed *BiomeCompileRules( int dims, mixed *rules, int defaultBiome );
+mixed *BiomeCompileTable( int dims, function classify );
+
+//--------------------------------------------------------------------------
+// Classify one set of channel values.
+//
+int BiomeLookup( mixed *table, float temperature, float moisture, float height );
+
+//--------------------------------------------------------------------------
+// Biome IDs for world cells (originX + x, originY + y), sampled at
+//  (cell / scale) with the given fBm octaves.
+//
+buffer BiomeMap( int originX, int originY, int width, int height, float scale, int octaves, mixed *table, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private float biome_bin_center( int bin )
+{
+	return ( bin + 0.5 ) * 2.0 / BIOME_LEVELS - 1.0;
+}
+
+//--------------------------------------------------------------------------
+private int biome_bin( float value )
+{
+	int bin = to_int( ( value + 1.0 ) * 0.5 * BIOME_LEVELS );
+
+	if( bin < 0 )
+		return 0;
+	if( bin >= BIOME_LEVELS )
+		return BIOME_LEVELS - 1;
+	return bin;
+}
+
+//--------------------------------------------------------------------------
+// Each channel gets a distinct seed so the channels are uncorrelated.
+//
+private int biome_channel_seed( int channel, int seed )
+{
+	return Get2dNoise( channel, seed, seed );
+}
+
+//--------------------------------------------------------------------------
+private int biome_match_rules( mixed *rules, int defaultBiome, float t, float m, float h )
+{
+	mixed *rule;
+
+	foreach( rule in rules )
+	{
+		if( t < rule[1] || t > rule[2] || m < rule[3] || m > rule[4] )
+			continue;
+		if( sizeof( rule ) > 5 && ( h < rule[5] || h > rule[6] ) )
+			continue;
+		return rule[0];
+	}
+	return defaultBiome;
+}
+
+//--------------------------------------------------------------------------
+mixed *BiomeCompileRules( int dims, mixed *rules, int defaultBiome )
+{
+	return BiomeCompileTable( dims,
+		(: biome_match_rules, rules, defaultBiome :) );
+}
+
+//--------------------------------------------------------------------------
+mixed *BiomeCompileTable( int dims, function classify )
+{
+	int levelsH = dims == 3 ? BIOME_LEVELS : 1;
+	buffer data = allocate_buffer( BIOME_LEVELS * BIOME_LEVELS * levelsH );
+	int t, m, h;
+
+	for( h = 0; h < levelsH; h++ )
+	{
+		for( m = 0; m < BIOME_LEVELS; m++ )
+		{
+			for( t = 0; t < BIOME_LEVELS; t++ )
+			{
+				data[ ( h * BIOME_LEVELS + m ) * BIOME_LEVELS + t ] = evaluate( classify,
+					biome_bin_center( t ), biome_bin_center( m ),
+					dims == 3 ? biome_bin_center( h ) : 0.0 ) & 0xFF;
+			}
+		}
+	}
+	return ({ dims, data });
+}
+
+//--------------------------------------------------------------------------
+int BiomeLookup( mixed *table, float temperature, float moisture, float height )
+{
+	int index = biome_bin( moisture ) * BIOME_LEVELS + biome_bin( temperature );
+
+	if( table[BIOME_TABLE_DIMS] == 3 )
+		index += biome_bin( height ) * BIOME_LEVELS * BIOME_LEVELS;
+	return table[BIOME_TABLE_DATA][index];
+}
+
+//--------------------------------------------------------------------------
+buffer BiomeMap( int originX, int originY, int width, int height, float scale, int octaves, mixed *table, int seed )
+{
+	int cells = width * height;
+	buffer result = allocate_buffer( cells );
+	buffer data = table[BIOME_TABLE_DATA];
+	float binScale = 0.5 * BIOME_LEVELS;
+	float *temperature, *moisture, *heights;
+	int i, t, m, h;
+
+	temperature = Get2dFbmGrid( originX, originY, width, height, scale, octaves,
+		biome_channel_seed( BIOME_TEMPERATURE, seed ) );
+	moisture = Get2dFbmGrid( originX, originY, width, height, scale, octaves,
+		biome_channel_seed( BIOME_MOISTURE, seed ) );
+	if( table[BIOME_TABLE_DIMS] == 3 )
+		heights = Get2dFbmGrid( originX, originY, width, height, scale, octaves,
+			biome_channel_seed( BIOME_HEIGHT, seed ) );
+
+	// biome_bin inlined: fBm output is already within [-1,1], so only the
+	//  top edge needs clamping
+	if( table[BIOME_TABLE_DIMS] == 3 )
+	{
+		for( i = 0; i < cells; i++ )
+		{
+			t = to_int( ( temperature[i] + 1.0 ) * binScale );
+			m = to_int( ( moisture[i] + 1.0 ) * binScale );
+			h = to_int( ( heights[i] + 1.0 ) * binScale );
+			if( t >= BIOME_LEVELS ) t = BIOME_LEVELS - 1;
+			if( m >= BIOME_LEVELS ) m = BIOME_LEVELS - 1;
+			if( h >= BIOME_LEVELS ) h = BIOME_LEVELS - 1;
+			result[i] = data[ ( h * BIOME_LEVELS + m ) * BIOME_LEVELS + t ];
+		}
+	}
+	else
+	{
+		for( i = 0; i < cells; i++ )
+		{
+			t = to_int( ( temperature[i] + 1.0 ) * binScale );
+			m = to_int( ( moisture[i] + 1.0 ) * binScale );
+			if( t >= BIOME_LEVELS ) t = BIOME_LEVELS - 1;
+			if( m >= BIOME_LEVELS ) m = BIOME_LEVELS - 1;
+			result[i] = data[ m * BIOME_LEVELS + t ];
+		}
+	}
+	return result;
+}
+
+#endif
@@ -0,0 +1,261 @@
+// cellular.h
+// Bit-parallel cellular automata over noise-seeded bitmaps
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _CELLULAR_H
+#define _CELLULAR_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Cellular automata (cave / dungeon smoothing)
+//
+// Bitmaps are packed 32 cells to an int, row-major, with CaRowWords(width)
+//  words per row.  Bit b of word w in row y is the cell at
+//  x = (w * 32) + b.  A set bit is a wall, a clear bit is open floor.  Bits
+//  past the right edge of a row are always stored clear.
+//
+// A CA step counts the eight neighbors of 32 cells at once with a
+//  bit-sliced adder (four bit planes holding counts 0..8), then applies the
+//  birth/survive rule with plain boolean logic, so the interpreter does a
+//  few dozen operations per 32 cells instead of nine lookups per cell.
+//  Cells outside the bitmap count as walls, which keeps caves closed.
+//
+// Rules are given as bitmasks over neighbor counts: bit n of birthMask set
+//  means an open cell with n wall neighbors becomes a wall; bit n of
+//  surviveMask set means a wall with n wall neighbors stays a wall.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define CA_BITS_PER_WORD        32
+
+// The usual "4-5" cave rule: become a wall with 5+ wall neighbors, stay a
+//  wall with 4+.
+#define CA_CAVE_BIRTH           0x1E0   // counts 5,6,7,8
+#define CA_CAVE_SURVIVE         0x1F0   // counts 4,5,6,7,8
+
+//--------------------------------------------------------------------------
+// Bitmap layout helpers.
+//
+int CaRowWords( int width );
+int CaPopcount( int word );
+int CaGetCell( int *bitmap, int width, int height, int posX, int posY );
+void CaSetCell( int *bitmap, int width, int height, int posX, int posY, int wall );
+
+//--------------------------------------------------------------------------
+// Seed a bitmap from noise: the cell at world position
+//  (originX + x, originY + y) is a wall when its Get2dNoiseZeroToOne value
+//  is below fillChance.
+//
+int *CaSeedBitmap( int originX, int originY, int width, int height, float fillChance, int seed );
+
+//--------------------------------------------------------------------------
+// Run one or more CA iterations; returns a new bitmap.
+//
+int *CaStep( int *bitmap, int width, int height, int birthMask, int surviveMask );
+int *CaSmooth( int *bitmap, int width, int height, int birthMask, int surviveMask, int iterations );
+
+//--------------------------------------------------------------------------
+// Seed and smooth with the cave rule in one call.
+//
+int *CaGenerateCave( int originX, int originY, int width, int height, float fillChance, int iterations, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+int CaRowWords( int width )
+{
+	return ( width + CA_BITS_PER_WORD - 1 ) / CA_BITS_PER_WORD;
+}
+
+//--------------------------------------------------------------------------
+// Set bits in one 32-bit word, e.g. the wall cells it holds.
+//
+int CaPopcount( int word )
+{
+	word = word - ( ( word >> 1 ) & 0x55555555 );
+	word = ( word & 0x33333333 ) + ( ( word >> 2 ) & 0x33333333 );
+	word = ( word + ( word >> 4 ) ) & 0x0F0F0F0F;
+	return ( ( word * 0x01010101 ) & INT_32_UNSIGNED_MAX ) >> 24;
+}
+
+//--------------------------------------------------------------------------
+// Mask of the bits in a row's last word that lie past the right edge.
+//
+private int ca_pad_mask( int width )
+{
+	int used = width % CA_BITS_PER_WORD;
+	if( !used )
+		return 0;
+	return ( INT_32_UNSIGNED_MAX << used ) & INT_32_UNSIGNED_MAX;
+}
+
+//--------------------------------------------------------------------------
+int CaGetCell( int *bitmap, int width, int height, int posX, int posY )
+{
+	if( posX < 0 || posY < 0 || posX >= width || posY >= height )
+		return 1;
+	return ( bitmap[ posY * CaRowWords( width ) + posX / CA_BITS_PER_WORD ]
+		>> ( posX % CA_BITS_PER_WORD ) ) & 1;
+}
+
+//--------------------------------------------------------------------------
+void CaSetCell( int *bitmap, int width, int height, int posX, int posY, int wall )
+{
+	int index;
+	int bit;
+
+	if( posX < 0 || posY < 0 || posX >= width || posY >= height )
+		return;
+	index = posY * CaRowWords( width ) + posX / CA_BITS_PER_WORD;
+	bit = 1 << ( posX % CA_BITS_PER_WORD );
+	if( wall )
+		bitmap[index] |= bit;
+	else
+		bitmap[index] &= ~bit & INT_32_UNSIGNED_MAX;
+}
+
+//--------------------------------------------------------------------------
+int *CaSeedBitmap( int originX, int originY, int width, int height, float fillChance, int seed )
+{
+	int rowWords = CaRowWords( width );
+	int *bitmap = allocate( rowWords * height );
+	int threshold = to_int( fillChance * INT_32_UNSIGNED_MAX );
+	int x, y, word;
+
+	for( y = 0; y < height; y++ )
+	{
+		for( x = 0; x < width; x++ )
+		{
+			if( Get2dNoise( originX + x, originY + y, seed ) < threshold )
+			{
+				word = y * rowWords + x / CA_BITS_PER_WORD;
+				bitmap[word] |= 1 << ( x % CA_BITS_PER_WORD );
+			}
+		}
+	}
+	return bitmap;
+}
+
+//--------------------------------------------------------------------------
+// One row of the bitmap with its padding bits set (out of bounds is wall)
+//  and an all-wall sentinel word on each side, so neighbor words can be
+//  fetched without bounds checks.  Rows outside the bitmap are all wall.
+//
+private int *ca_padded_row( int *bitmap, int rowWords, int height, int padMask, int posY )
+{
+	int *row;
+
+	if( posY < 0 || posY >= height )
+		return allocate( rowWords + 2, INT_32_UNSIGNED_MAX );
+
+	row = ({ INT_32_UNSIGNED_MAX })
+		+ bitmap[ posY * rowWords .. posY * rowWords + rowWords - 1 ]
+		+ ({ INT_32_UNSIGNED_MAX });
+	row[rowWords] |= padMask;
+	return row;
+}
+
+//--------------------------------------------------------------------------
+int *CaStep( int *bitmap, int width, int height, int birthMask, int surviveMask )
+{
+	int rowWords = CaRowWords( width );
+	int padMask = ca_pad_mask( width );
+	int *result = allocate( rowWords * height );
+	int *birthCounts = ({});
+	int *surviveCounts = ({});
+	int *above, *current, *below;
+	int y, w, i, c;
+	int n0, n1, n2, n3, n4, n5, n6, n7;
+	int a1, a2, b1, b2, c1, c2, d1, d2, e2, e4, f4;
+	int bit0, bit1, bit2, bit3;
+	int self, born, survive, match;
+
+	for( c = 0; c <= 8; c++ )
+	{
+		if( birthMask & ( 1 << c ) )
+			birthCounts += ({ c });
+		if( surviveMask & ( 1 << c ) )
+			surviveCounts += ({ c });
+	}
+
+	above = ca_padded_row( bitmap, rowWords, height, padMask, -1 );
+	current = ca_padded_row( bitmap, rowWords, height, padMask, 0 );
+	for( y = 0; y < height; y++ )
+	{
+		below = ca_padded_row( bitmap, rowWords, height, padMask, y + 1 );
+		for( w = 1; w <= rowWords; w++ )
+		{
+			// Eight neighbor planes: bit b of each holds the neighbor of cell b
+			self = current[w];
+			n0 = ( ( above[w] << 1 ) | ( above[w - 1] >> 31 ) ) & INT_32_UNSIGNED_MAX;
+			n1 = above[w];
+			n2 = ( ( above[w] >> 1 ) | ( above[w + 1] << 31 ) ) & INT_32_UNSIGNED_MAX;
+			n3 = ( ( self << 1 ) | ( current[w - 1] >> 31 ) ) & INT_32_UNSIGNED_MAX;
+			n4 = ( ( self >> 1 ) | ( current[w + 1] << 31 ) ) & INT_32_UNSIGNED_MAX;
+			n5 = ( ( below[w] << 1 ) | ( below[w - 1] >> 31 ) ) & INT_32_UNSIGNED_MAX;
+			n6 = below[w];
+			n7 = ( ( below[w] >> 1 ) | ( below[w + 1] << 31 ) ) & INT_32_UNSIGNED_MAX;
+
+			// Bit-sliced sum of the eight planes into a 4-bit count
+			a1 = n0 ^ n1 ^ n2;
+			a2 = ( n0 & n1 ) | ( n2 & ( n0 ^ n1 ) );
+			b1 = n3 ^ n4 ^ n5;
+			b2 = ( n3 & n4 ) | ( n5 & ( n3 ^ n4 ) );
+			c1 = n6 ^ n7 ^ a1;
+			c2 = ( n6 & n7 ) | ( a1 & ( n6 ^ n7 ) );
+			d1 = b1 ^ c1;
+			d2 = b1 & c1;
+			e2 = a2 ^ b2 ^ c2;
+			e4 = ( a2 & b2 ) | ( c2 & ( a2 ^ b2 ) );
+			bit0 = d1;
+			bit1 = e2 ^ d2;
+			f4 = e2 & d2;
+			bit2 = e4 ^ f4;
+			bit3 = e4 & f4;
+
+			born = 0;
+			foreach( c in birthCounts )
+			{
+				match = ( c & 1 ? bit0 : ~bit0 ) & ( c & 2 ? bit1 : ~bit1 )
+					& ( c & 4 ? bit2 : ~bit2 ) & ( c & 8 ? bit3 : ~bit3 );
+				born |= match;
+			}
+			survive = 0;
+			foreach( c in surviveCounts )
+			{
+				match = ( c & 1 ? bit0 : ~bit0 ) & ( c & 2 ? bit1 : ~bit1 )
+					& ( c & 4 ? bit2 : ~bit2 ) & ( c & 8 ? bit3 : ~bit3 );
+				survive |= match;
+			}
+
+			i = y * rowWords + w - 1;
+			result[i] = ( ( born & ~self ) | ( survive & self ) ) & INT_32_UNSIGNED_MAX;
+			if( w == rowWords )
+				result[i] &= ~padMask;
+		}
+		above = current;
+		current = below;
+	}
+	return result;
+}
+
+//--------------------------------------------------------------------------
+int *CaSmooth( int *bitmap, int width, int height, int birthMask, int surviveMask, int iterations )
+{
+	while( iterations-- > 0 )
+		bitmap = CaStep( bitmap, width, height, birthMask, surviveMask );
+	return bitmap;
+}
+
+//--------------------------------------------------------------------------
+int *CaGenerateCave( int originX, int originY, int width, int height, float fillChance, int iterations, int seed )
+{
+	int *bitmap = CaSeedBitmap( originX, originY, width, height, fillChance, seed );
+	return CaSmooth( bitmap, width, height, CA_CAVE_BIRTH, CA_CAVE_SURVIVE, iterations );
+}
+
+#endif
@@ -0,0 +1,208 @@
+// desccache.h
+// Lazily generated, memoized room description fragments
+// Built for use with noise.h (SquirrelNoise5) generators
+
+#ifndef _DESCCACHE_H
+#define _DESCCACHE_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Description cache
+//
+// Room descriptions built from noise-selected fragments (weather, flora,
+//  sounds, ...) only change when the time bucket changes, so each fragment
+//  is generated on first access and memoized per (kind, room coordinates,
+//  time bucket, seed, noise algorithm ID).  Repeated looks in the same room
+//  cost one mapping lookup per fragment.
+//
+// Fragment generators are registered by kind and called as
+//  generator( x, y, z, bucket, seed ); they should be pure functions of
+//  those arguments (Get*dNoise-based), which is what makes caching safe.
+//
+// Eviction:
+//  - when the time bucket moves on, entries from older buckets are dropped
+//    (they can never be hit again);
+//  - past DESC_CACHE_CAPACITY entries, the least recently used quarter goes;
+//  - if a memory limit is set, memory_info() is checked every
+//    DESC_MEMORY_CHECK_EVERY inserts and half the cache is dropped while
+//    the driver is over the limit.  DescCacheTrim can also be called
+//    directly from a memory-pressure hook.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define DESC_TIME_BUCKET        900     // Seconds per time bucket
+#define DESC_CACHE_CAPACITY     4096
+#define DESC_MEMORY_CHECK_EVERY 256
+
+// Entry layout
+#define DESC_ENTRY_TEXT         0
+#define DESC_ENTRY_BUCKET       1
+#define DESC_ENTRY_USED         2
+
+//--------------------------------------------------------------------------
+// Fragment generators.
+//
+void DescRegisterFragment( string kind, function generator );
+
+//--------------------------------------------------------------------------
+// A single fragment, or several joined with spaces (empty fragments are
+//  skipped).  time is in seconds, e.g. time().
+//
+string DescFragment( string kind, int posX, int posY, int posZ, int time, int seed );
+string DescRoom( string *kinds, int posX, int posY, int posZ, int time, int seed );
+
+//--------------------------------------------------------------------------
+// Housekeeping.  DescCacheTrim keeps the most recently used fraction
+//  (0.0 empties the cache).  A memory limit of 0 disables the check.
+//
+void DescCacheTrim( float keep );
+void DescCacheSetMemoryLimit( int bytes );
+mapping DescCacheStats();
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// kind -> generator
+nosave private mapping desc_generators = ([]);
+// key -> ({ text, bucket, last use })
+nosave private mapping desc_cache = ([]);
+nosave private int desc_clock;
+nosave private int desc_bucket;
+nosave private int desc_memory_limit;
+nosave private int desc_inserts;
+nosave private int desc_hits;
+nosave private int desc_misses;
+nosave private string desc_algorithm;
+
+//--------------------------------------------------------------------------
+void DescRegisterFragment( string kind, function generator )
+{
+	desc_generators[kind] = generator;
+}
+
+//--------------------------------------------------------------------------
+void DescCacheTrim( float keep )
+{
+	string *cached = keys( desc_cache );
+	int *uses;
+	int cutoff, i;
+
+	if( keep <= 0.0 || !sizeof( cached ) )
+	{
+		desc_cache = ([]);
+		return;
+	}
+	if( keep >= 1.0 )
+		return;
+
+	uses = allocate( sizeof( cached ) );
+	for( i = 0; i < sizeof( cached ); i++ )
+		uses[i] = desc_cache[ cached[i] ][DESC_ENTRY_USED];
+	uses = sort_array( uses, 1 );
+	cutoff = uses[ to_int( sizeof( uses ) * ( 1.0 - keep ) ) ];
+
+	for( i = 0; i < sizeof( cached ); i++ )
+		if( desc_cache[ cached[i] ][DESC_ENTRY_USED] < cutoff )
+			map_delete( desc_cache, cached[i] );
+}
+
+//--------------------------------------------------------------------------
+// Drop entries from buckets before the current one.  The previous bucket
+//  is kept too, for callers still a little behind the clock.
+//
+private void desc_drop_old_buckets()
+{
+	string key;
+
+	foreach( key in keys( desc_cache ) )
+		if( desc_cache[key][DESC_ENTRY_BUCKET] < desc_bucket - 1 )
+			map_delete( desc_cache, key );
+}
+
+//--------------------------------------------------------------------------
+private void desc_insert( string key, string text, int bucket )
+{
+	desc_cache[key] = ({ text, bucket, ++desc_clock });
+
+	if( sizeof( desc_cache ) > DESC_CACHE_CAPACITY )
+		DescCacheTrim( 0.75 );
+
+	if( desc_memory_limit && ++desc_inserts % DESC_MEMORY_CHECK_EVERY == 0 )
+		if( memory_info() > desc_memory_limit )
+			DescCacheTrim( 0.5 );
+}
+
+//--------------------------------------------------------------------------
+string DescFragment( string kind, int posX, int posY, int posZ, int time, int seed )
+{
+	int bucket = time / DESC_TIME_BUCKET;
+	string key;
+	mixed *entry;
+	function generator;
+	string text;
+
+	if( !desc_algorithm )
+		desc_algorithm = NoiseAlgorithmId();
+	key = sprintf( "%s:%s:%d:%d:%d:%d:%d", desc_algorithm, kind, posX, posY, posZ, bucket, seed );
+	entry = desc_cache[key];
+
+	if( bucket > desc_bucket )
+	{
+		desc_bucket = bucket;
+		desc_drop_old_buckets();
+	}
+
+	if( entry )
+	{
+		desc_hits++;
+		entry[DESC_ENTRY_USED] = ++desc_clock;
+		return entry[DESC_ENTRY_TEXT];
+	}
+
+	desc_misses++;
+	generator = desc_generators[kind];
+	if( !generator )
+		return "";
+	text = evaluate( generator, posX, posY, posZ, bucket, seed );
+	if( !stringp( text ) )
+		text = "";
+	desc_insert( key, text, bucket );
+	return text;
+}
+
+//--------------------------------------------------------------------------
+string DescRoom( string *kinds, int posX, int posY, int posZ, int time, int seed )
+{
+	string *parts = ({});
+	string kind, text;
+
+	foreach( kind in kinds )
+	{
+		text = DescFragment( kind, posX, posY, posZ, time, seed );
+		if( text != "" )
+			parts += ({ text });
+	}
+	return implode( parts, " " );
+}
+
+//--------------------------------------------------------------------------
+void DescCacheSetMemoryLimit( int bytes )
+{
+	desc_memory_limit = bytes;
+}
+
+//--------------------------------------------------------------------------
+mapping DescCacheStats()
+{
+	return ([
+		"entries" : sizeof( desc_cache ),
+		"bucket" : desc_bucket,
+		"hits" : desc_hits,
+		"misses" : desc_misses,
+	]);
+}
+
+#endif
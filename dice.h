@@ -0,0 +1,242 @@
+// dice.h
+// Deterministic dice expressions with compiled roll plans
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _DICE_H
+#define _DICE_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Dice
+//
+// Expressions are sums and differences of dice and constants, such as
+//  "3d6+2d4+5", "d20 - 1" or "2d8-1d4".  An expression is compiled once into
+//  a roll plan; plans are cached by expression string, so DiceRollString
+//  only parses a given string the first time it sees it.  Strings that do
+//  not parse are cached too, and the cache is reset once it holds
+//  DICE_PLAN_CACHE_SIZE strings, so player-supplied expressions cannot grow
+//  it without bound.
+//
+// Rolling a plan is a pure function of (index, seed).  Instead of one hash
+//  per die, dice are drawn from a bit pool: each Get2dNoise( index, n, seed )
+//  call yields 32 bits and each die takes just the bits it needs (3 for a
+//  d6, 5 for a d20), rejecting and redrawing out-of-range values so every
+//  face stays equally likely.  A 3d6+2d4 roll usually needs one hash.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define DICE_MAX_SIDES          65536
+#define DICE_MAX_COUNT          1000
+#define DICE_PLAN_CACHE_SIZE    256     // Expressions kept before the cache is reset
+
+// Roll plan layout
+#define DICE_PLAN_CONSTANT      0       // int: sum of the constant terms
+#define DICE_PLAN_TERMS         1       // ({ ({ count, sides, sign, bits, mask }), ... })
+
+#define DICE_TERM_COUNT         0
+#define DICE_TERM_SIDES         1
+#define DICE_TERM_SIGN          2
+#define DICE_TERM_BITS          3
+#define DICE_TERM_MASK          4
+
+//--------------------------------------------------------------------------
+// Compile an expression into a roll plan; returns 0 if it does not parse.
+//
+mixed *DiceCompile( string expression );
+
+//--------------------------------------------------------------------------
+// Roll a compiled plan.  The batch form rolls count consecutive indices
+//  from startIndex, e.g. one per attacker.
+//
+int DiceRoll( mixed *plan, int index, int seed );
+int *DiceRollBatch( mixed *plan, int startIndex, int count, int seed );
+
+//--------------------------------------------------------------------------
+// Compile (cached) and roll in one call.  Unparseable expressions roll 0.
+//
+int DiceRollString( string expression, int index, int seed );
+
+//--------------------------------------------------------------------------
+// Smallest and largest possible results of a plan.
+//
+int DiceMinimum( mixed *plan );
+int DiceMaximum( mixed *plan );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// expression -> plan, or 0 if it does not parse
+nosave private mapping dice_plans = ([]);
+
+//--------------------------------------------------------------------------
+// Bits needed to hold values 0 .. sides - 1.
+//
+private int dice_bits_for( int sides )
+{
+	int bits = 0;
+
+	while( ( 1 << bits ) < sides )
+		bits++;
+	return bits;
+}
+
+//--------------------------------------------------------------------------
+// Parse one term ("3d6", "d20", "5"); returns ({ count, sides }) with
+//  sides 0 for a constant, or 0 if the term is malformed.
+//
+private int *dice_parse_term( string term )
+{
+	int count, sides;
+	string rest;
+
+	if( term == "" )
+		return 0;
+	if( term[0] == 'd' )
+		term = "1" + term;
+
+	if( sscanf( term, "%dd%s", count, rest ) == 2 )
+	{
+		if( sscanf( rest, "%d", sides ) != 1 || sprintf( "%d", sides ) != rest )
+			return 0;
+		if( count < 0 || count > DICE_MAX_COUNT || sides < 1 || sides > DICE_MAX_SIDES )
+			return 0;
+		return ({ count, sides });
+	}
+	if( sscanf( term, "%d", count ) == 1 && sprintf( "%d", count ) == term )
+		return ({ count, 0 });
+	return 0;
+}
+
+//--------------------------------------------------------------------------
+mixed *DiceCompile( string expression )
+{
+	mixed *terms = ({});
+	int constant = 0;
+	int sign = 1;
+	int start = 0;
+	int *term;
+	int i;
+
+	expression = lower_case( replace_string( expression, " ", "" ) );
+	if( expression == "" )
+		return 0;
+	if( expression[0] == '-' || expression[0] == '+' )
+	{
+		sign = expression[0] == '-' ? -1 : 1;
+		start = 1;
+	}
+
+	for( i = start; i <= strlen( expression ); i++ )
+	{
+		if( i < strlen( expression ) && expression[i] != '+' && expression[i] != '-' )
+			continue;
+
+		term = dice_parse_term( expression[start .. i - 1] );
+		if( !term )
+			return 0;
+		if( term[1] )
+			terms += ({ ({ term[0], term[1], sign, dice_bits_for( term[1] ),
+				( 1 << dice_bits_for( term[1] ) ) - 1 }) });
+		else
+			constant += sign * term[0];
+
+		if( i < strlen( expression ) )
+			sign = expression[i] == '-' ? -1 : 1;
+		start = i + 1;
+	}
+	return ({ constant, terms });
+}
+
+//--------------------------------------------------------------------------
+int DiceRoll( mixed *plan, int index, int seed )
+{
+	int total = plan[DICE_PLAN_CONSTANT];
+	int pool = 0;
+	int poolBits = 0;
+	int draws = 0;
+	int bits, mask, sides, die, value, sum;
+	mixed *term;
+
+	foreach( term in plan[DICE_PLAN_TERMS] )
+	{
+		sides = term[DICE_TERM_SIDES];
+		bits = term[DICE_TERM_BITS];
+		mask = term[DICE_TERM_MASK];
+		sum = 0;
+		for( die = 0; die < term[DICE_TERM_COUNT]; die++ )
+		{
+			do
+			{
+				if( poolBits < bits )
+				{
+					pool = Get2dNoise( index, draws++, seed );
+					poolBits = 32;
+				}
+				value = pool & mask;
+				pool >>= bits;
+				poolBits -= bits;
+			}
+			while( value >= sides );
+			sum += value + 1;
+		}
+		total += term[DICE_TERM_SIGN] * sum;
+	}
+	return total;
+}
+
+//--------------------------------------------------------------------------
+int *DiceRollBatch( mixed *plan, int startIndex, int count, int seed )
+{
+	int *result = allocate( count );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		result[i] = DiceRoll( plan, startIndex + i, seed );
+	return result;
+}
+
+//--------------------------------------------------------------------------
+int DiceRollString( string expression, int index, int seed )
+{
+	mixed *plan = dice_plans[expression];
+
+	if( undefinedp( plan ) )
+	{
+		plan = DiceCompile( expression );
+		if( sizeof( dice_plans ) >= DICE_PLAN_CACHE_SIZE )
+			dice_plans = ([]);
+		dice_plans[expression] = plan;
+	}
+	return plan ? DiceRoll( plan, index, seed ) : 0;
+}
+
+//--------------------------------------------------------------------------
+int DiceMinimum( mixed *plan )
+{
+	int total = plan[DICE_PLAN_CONSTANT];
+	mixed *term;
+
+	foreach( term in plan[DICE_PLAN_TERMS] )
+		total += term[DICE_TERM_SIGN] > 0
+			? term[DICE_TERM_COUNT]
+			: -term[DICE_TERM_COUNT] * term[DICE_TERM_SIDES];
+	return total;
+}
+
+//--------------------------------------------------------------------------
+int DiceMaximum( mixed *plan )
+{
+	int total = plan[DICE_PLAN_CONSTANT];
+	mixed *term;
+
+	foreach( term in plan[DICE_PLAN_TERMS] )
+		total += term[DICE_TERM_SIGN] > 0
+			? term[DICE_TERM_COUNT] * term[DICE_TERM_SIDES]
+			: -term[DICE_TERM_COUNT];
+	return total;
+}
+
+#endif
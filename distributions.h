@@ -0,0 +1,316 @@
+// distributions.h
+// Non-uniform distributions keyed by index and seed
+// Built on noise.h (SquirrelNoise5), gaussian.h, cellular.h (popcount) and
+//  tilecache.h
+
+#ifndef _DISTRIBUTIONS_H
+#define _DISTRIBUTIONS_H
+
+#include "noise.h"
+#include "gaussian.h"
+#include "cellular.h"
+#include "tilecache.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Distributions
+//
+// Every sampler is a pure function of (index, parameters, seed), just like
+//  Get1dNoise: the same spawn timer or loot roll always comes out the same,
+//  in any order.
+//
+// Exponential: inverse transform, one hash.
+// Poisson and binomial: for small parameters the CDF is tabulated once per
+//  parameter set (and kept), then a sample is one hash and a binary
+//  search.  The last table used by each sampler is remembered with its
+//  parameters, so a run of samples with the same parameters never builds
+//  a cache key.  A fair binomial with up to 32 trials is just a bit count of
+//  one hash.  Large parameters fall back to a normal approximation, also
+//  one hash.
+// Gamma: Marsaglia and Tsang's method.  It rejects a few percent of
+//  attempts, so attempt k draws from Get3dNoise( index, k, ... ); the
+//  sample still depends only on index and seed.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define DIST_TABLE_MAX_MEAN     64      // Largest lambda / trials kept as a CDF table
+#define DIST_TABLE_CACHE_SIZE   256     // Parameter sets kept before the cache is reset
+#define DIST_GAMMA_MAX_TRIES    32
+
+//--------------------------------------------------------------------------
+// Single samples.
+//
+float Get1dNoiseExponential( int index, float rate, int seed );
+int Get1dNoisePoisson( int index, float lambda, int seed );
+int Get1dNoiseBinomial( int index, int trials, float chance, int seed );
+float Get1dNoiseGamma( int index, float shape, float scale, int seed );
+
+//--------------------------------------------------------------------------
+// Batch forms over count consecutive indices from startIndex.
+//
+float *Get1dNoiseExponentialBatch( int startIndex, int count, float rate, int seed );
+int *Get1dNoisePoissonBatch( int startIndex, int count, float lambda, int seed );
+int *Get1dNoiseBinomialBatch( int startIndex, int count, int trials, float chance, int seed );
+float *Get1dNoiseGammaBatch( int startIndex, int count, float shape, float scale, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// parameter key -> float * CDF
+nosave private mapping dist_cdf_tables = ([]);
+
+// Last table used by each sampler, checked before the keyed cache
+nosave private float dist_last_lambda;
+nosave private float *dist_last_poisson;
+nosave private int dist_last_trials;
+nosave private float dist_last_chance;
+nosave private float *dist_last_binomial;
+
+//--------------------------------------------------------------------------
+// 32 noise bits as a float strictly inside (0,1).
+//
+private float dist_open_unit( int bits )
+{
+	return ( bits + 0.5 ) / ( 1.0 + INT_32_UNSIGNED_MAX );
+}
+
+//--------------------------------------------------------------------------
+// Smallest k with cdf[k] > u.  The last entry is always 1.0.
+//
+private int dist_search_cdf( float *cdf, float u )
+{
+	int low = 0;
+	int high = sizeof( cdf ) - 1;
+	int middle;
+
+	while( low < high )
+	{
+		middle = ( low + high ) / 2;
+		if( cdf[middle] > u )
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	return low;
+}
+
+//--------------------------------------------------------------------------
+private void dist_store_table( string key, float *cdf )
+{
+	if( sizeof( dist_cdf_tables ) >= DIST_TABLE_CACHE_SIZE )
+		dist_cdf_tables = ([]);
+	dist_cdf_tables[key] = cdf;
+}
+
+//--------------------------------------------------------------------------
+private float *dist_poisson_table( float lambda )
+{
+	string key;
+	float *cdf;
+	float pmf, total;
+	int k, last;
+
+	if( dist_last_poisson && lambda == dist_last_lambda )
+		return dist_last_poisson;
+
+	key = "poisson:" + TileCacheEncodeFloat( lambda );
+	cdf = dist_cdf_tables[key];
+	dist_last_lambda = lambda;
+	if( cdf )
+		return dist_last_poisson = cdf;
+
+	// Out to where the remaining tail is negligible
+	last = to_int( lambda + 12.0 * sqrt( lambda ) ) + 20;
+	cdf = allocate( last + 1, 0.0 );
+	pmf = exp( -lambda );
+	total = 0.0;
+	for( k = 0; k < last; k++ )
+	{
+		total += pmf;
+		cdf[k] = total;
+		pmf *= lambda / ( k + 1 );
+	}
+	cdf[last] = 1.0;
+	dist_store_table( key, cdf );
+	return dist_last_poisson = cdf;
+}
+
+//--------------------------------------------------------------------------
+private float *dist_binomial_table( int trials, float chance )
+{
+	string key;
+	float *cdf;
+	float pmf, total, odds;
+	int k;
+
+	if( dist_last_binomial && trials == dist_last_trials && chance == dist_last_chance )
+		return dist_last_binomial;
+
+	key = sprintf( "binomial:%d:%s", trials, TileCacheEncodeFloat( chance ) );
+	cdf = dist_cdf_tables[key];
+	dist_last_trials = trials;
+	dist_last_chance = chance;
+	if( cdf )
+		return dist_last_binomial = cdf;
+
+	cdf = allocate( trials + 1, 0.0 );
+	pmf = pow( 1.0 - chance, trials );
+	odds = chance / ( 1.0 - chance );
+	total = 0.0;
+	for( k = 0; k < trials; k++ )
+	{
+		total += pmf;
+		cdf[k] = total;
+		pmf *= odds * ( trials - k ) / ( k + 1 );
+	}
+	cdf[trials] = 1.0;
+	dist_store_table( key, cdf );
+	return dist_last_binomial = cdf;
+}
+
+//--------------------------------------------------------------------------
+float Get1dNoiseExponential( int index, float rate, int seed )
+{
+	return -log( dist_open_unit( Get1dNoise( index, seed ) ) ) / rate;
+}
+
+//--------------------------------------------------------------------------
+int Get1dNoisePoisson( int index, float lambda, int seed )
+{
+	int bits = Get1dNoise( index, seed );
+	int result;
+
+	if( lambda <= 0.0 )
+		return 0;
+	if( lambda <= DIST_TABLE_MAX_MEAN )
+		return dist_search_cdf( dist_poisson_table( lambda ), dist_open_unit( bits ) );
+
+	result = to_int( floor( lambda + sqrt( lambda ) * NoiseBitsToGaussian( bits ) + 0.5 ) );
+	return result < 0 ? 0 : result;
+}
+
+//--------------------------------------------------------------------------
+int Get1dNoiseBinomial( int index, int trials, float chance, int seed )
+{
+	int bits = Get1dNoise( index, seed );
+	float mean, deviation;
+	int result;
+
+	if( trials <= 0 || chance <= 0.0 )
+		return 0;
+	if( chance >= 1.0 )
+		return trials;
+
+	// Fair coins: one noise bit per trial
+	if( chance == 0.5 && trials <= 32 )
+		return CaPopcount( bits & ( ( 1 << trials ) - 1 ) );
+
+	if( trials <= DIST_TABLE_MAX_MEAN )
+		return dist_search_cdf( dist_binomial_table( trials, chance ), dist_open_unit( bits ) );
+
+	mean = trials * chance;
+	deviation = sqrt( mean * ( 1.0 - chance ) );
+	result = to_int( floor( mean + deviation * NoiseBitsToGaussian( bits ) + 0.5 ) );
+	return result < 0 ? 0 : ( result > trials ? trials : result );
+}
+
+//--------------------------------------------------------------------------
+float Get1dNoiseGamma( int index, float shape, float scale, int seed )
+{
+	float d, c, x, v, u;
+	float boost = 1.0;
+	int attempt;
+
+	if( shape <= 0.0 )
+		return 0.0;
+
+	// Shape below one: sample shape + 1 and scale down by u^(1/shape)
+	if( shape < 1.0 )
+	{
+		boost = pow( dist_open_unit( Get3dNoise( index, -1, 0, seed ) ), 1.0 / shape );
+		shape += 1.0;
+	}
+
+	d = shape - 1.0 / 3.0;
+	c = 1.0 / sqrt( 9.0 * d );
+	for( attempt = 0; attempt < DIST_GAMMA_MAX_TRIES; attempt++ )
+	{
+		x = Get3dNoiseGaussian( index, attempt, 0, seed );
+		v = 1.0 + c * x;
+		if( v <= 0.0 )
+			continue;
+		v = v * v * v;
+		u = dist_open_unit( Get3dNoise( index, attempt, 1, seed ) );
+		if( u < 1.0 - 0.0331 * x * x * x * x
+			|| log( u ) < 0.5 * x * x + d * ( 1.0 - v + log( v ) ) )
+			return d * v * boost * scale;
+	}
+	// Practically unreachable; the mean is a safe answer
+	return shape * boost * scale;
+}
+
+//--------------------------------------------------------------------------
+float *Get1dNoiseExponentialBatch( int startIndex, int count, float rate, int seed )
+{
+	float *result = allocate( count, 0.0 );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		result[i] = -log( dist_open_unit( Get1dNoise( startIndex + i, seed ) ) ) / rate;
+	return result;
+}
+
+//--------------------------------------------------------------------------
+int *Get1dNoisePoissonBatch( int startIndex, int count, float lambda, int seed )
+{
+	int *result = allocate( count );
+	float *cdf;
+	int i;
+
+	if( lambda <= 0.0 || lambda > DIST_TABLE_MAX_MEAN )
+	{
+		for( i = 0; i < count; i++ )
+			result[i] = Get1dNoisePoisson( startIndex + i, lambda, seed );
+		return result;
+	}
+
+	cdf = dist_poisson_table( lambda );
+	for( i = 0; i < count; i++ )
+		result[i] = dist_search_cdf( cdf, dist_open_unit( Get1dNoise( startIndex + i, seed ) ) );
+	return result;
+}
+
+//--------------------------------------------------------------------------
+int *Get1dNoiseBinomialBatch( int startIndex, int count, int trials, float chance, int seed )
+{
+	int *result = allocate( count );
+	float *cdf;
+	int i;
+
+	if( trials <= 0 || trials > DIST_TABLE_MAX_MEAN || chance <= 0.0 || chance >= 1.0
+		|| ( chance == 0.5 && trials <= 32 ) )
+	{
+		for( i = 0; i < count; i++ )
+			result[i] = Get1dNoiseBinomial( startIndex + i, trials, chance, seed );
+		return result;
+	}
+
+	cdf = dist_binomial_table( trials, chance );
+	for( i = 0; i < count; i++ )
+		result[i] = dist_search_cdf( cdf, dist_open_unit( Get1dNoise( startIndex + i, seed ) ) );
+	return result;
+}
+
+//--------------------------------------------------------------------------
+float *Get1dNoiseGammaBatch( int startIndex, int count, float shape, float scale, int seed )
+{
+	float *result = allocate( count, 0.0 );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		result[i] = Get1dNoiseGamma( startIndex + i, shape, scale, seed );
+	return result;
+}
+
+#endif
@@ -0,0 +1,376 @@
+// erosion.h
+// Thermal and hydraulic erosion over noise heightmaps
+// Built on noise.h (SquirrelNoise5), valuenoise.h (fBm heightmaps) and
+//  tilecache.h
+
+#ifndef _EROSION_H
+#define _EROSION_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "tilecache.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Erosion
+//
+// Heightmaps are row-major float arrays (index = y * width + x), as
+//  returned by Get2dFbmGrid.  Both passes modify the array in place.
+//
+// Thermal erosion moves material from a cell to its lowest neighbor when
+//  the slope between them is steeper than the talus threshold.  Each
+//  iteration gathers all moves first and applies them afterwards, so the
+//  result does not depend on scan order.
+//
+// Hydraulic erosion simulates water droplets that pick up sediment while
+//  running downhill and drop it when they slow down.  Droplet start points
+//  are drawn from Get2dNoiseZeroToOne( droplet, axis, seed ), so a given
+//  seed always erodes the same way.
+//
+// Tiles: ErosionErodeTile generates a tile with a halo of extra cells on
+//  every side, erodes the whole thing and keeps only the interior.  A tile
+//  therefore depends only on its own coordinates and the seed, never on
+//  which tiles were processed before it, and tiles can be produced in any
+//  order.
+//
+// Tile droplets are keyed by world position, not by tile: the world is cut
+//  into EROSION_DROP_BLOCK square blocks, each with its own droplets
+//  starting at Get3dNoiseZeroToOne( blockX, blockY, n, seed ), and a tile
+//  runs every block that lies inside its tile-plus-halo area, in world
+//  order.  Where two tiles' areas overlap they replay the same droplets, so
+//  channels carry on across tile edges.  The match is not exact: a tile
+//  never sees droplets from beyond its halo, nor the terrain they would
+//  have carved, so heights next to a tile edge can differ a little between
+//  the two sides.  A wider halo shrinks the difference at the cost of more
+//  cells per tile; #define EROSION_HALO before including this file.
+//  Finished tiles are kept in the tile cache, keyed with the halo.
+//
+// Background work: ErosionQueueTile runs one tile per call_out so large
+//  regions can be eroded without hitting eval limits; results are handed to
+//  a callback.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef EROSION_HALO
+#define EROSION_HALO            16      // Extra cells around each tile
+#endif
+#define EROSION_DROP_BLOCK      8       // World cells per side of a droplet block
+
+#define EROSION_INERTIA         0.05    // How much a droplet keeps its heading
+#define EROSION_CAPACITY        4.0     // Sediment capacity multiplier
+#define EROSION_MIN_CAPACITY    0.01
+#define EROSION_DEPOSIT         0.3     // Fraction of excess sediment dropped
+#define EROSION_ERODE           0.3     // Fraction of free capacity eroded
+#define EROSION_EVAPORATE       0.01
+#define EROSION_GRAVITY         4.0
+#define EROSION_MAX_STEPS       64
+
+#define EROSION_THERMAL_TALUS   0.01
+#define EROSION_THERMAL_RATE    0.5
+#define EROSION_THERMAL_STEPS   8
+
+//--------------------------------------------------------------------------
+// In-place passes over a width x height heightmap.
+//
+void ErosionThermal( float *heights, int width, int height, float talus, float rate, int iterations );
+void ErosionHydraulic( float *heights, int width, int height, int droplets, int seed );
+
+//--------------------------------------------------------------------------
+// One eroded tileSize x tileSize tile of fBm terrain at tile coordinates
+//  (tileX, tileY), through the tile cache.  Terrain is
+//  Get2dFbmGrid( ..., scale, octaves, seed ); droplets is the count per
+//  tile interior, spread evenly over the droplet blocks.
+//
+float *ErosionErodeTile( int tileX, int tileY, int tileSize, float scale, int octaves, int droplets, int seed );
+
+//--------------------------------------------------------------------------
+// Queue a tile for background erosion.  When it is done,
+//  callback( tileX, tileY, heights ) is called.
+//
+void ErosionQueueTile( int tileX, int tileY, int tileSize, float scale, int octaves, int droplets, int seed, function callback );
+int ErosionQueueLength();
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+nosave private mixed *erosion_queue = ({});
+
+//--------------------------------------------------------------------------
+void ErosionThermal( float *heights, int width, int height, float talus, float rate, int iterations )
+{
+	float *delta;
+	float here, diff, steepest, amount;
+	int x, y, i, target, iteration;
+
+	for( iteration = 0; iteration < iterations; iteration++ )
+	{
+		delta = allocate( width * height, 0.0 );
+		for( y = 0; y < height; y++ )
+		{
+			for( x = 0; x < width; x++ )
+			{
+				i = y * width + x;
+				here = heights[i];
+				steepest = talus;
+				target = -1;
+				if( x > 0 && here - heights[i - 1] > steepest )
+				{
+					steepest = here - heights[i - 1];
+					target = i - 1;
+				}
+				if( x < width - 1 && here - heights[i + 1] > steepest )
+				{
+					steepest = here - heights[i + 1];
+					target = i + 1;
+				}
+				if( y > 0 && here - heights[i - width] > steepest )
+				{
+					steepest = here - heights[i - width];
+					target = i - width;
+				}
+				if( y < height - 1 && here - heights[i + width] > steepest )
+				{
+					steepest = here - heights[i + width];
+					target = i + width;
+				}
+				if( target < 0 )
+					continue;
+
+				// Half the excess levels the pair; rate scales how much of it moves
+				diff = steepest - talus;
+				amount = rate * diff * 0.5;
+				delta[i] -= amount;
+				delta[target] += amount;
+			}
+		}
+		for( i = 0; i < width * height; i++ )
+			heights[i] += delta[i];
+	}
+}
+
+//--------------------------------------------------------------------------
+// Bilinear height and gradient at a position inside the map; returns
+//  ({ height, gradientX, gradientY }).
+//
+private float *erosion_sample( float *heights, int width, float posX, float posY )
+{
+	int nodeX = to_int( posX );
+	int nodeY = to_int( posY );
+	float u = posX - nodeX;
+	float v = posY - nodeY;
+	int i = nodeY * width + nodeX;
+	float nw = heights[i];
+	float ne = heights[i + 1];
+	float sw = heights[i + width];
+	float se = heights[i + width + 1];
+
+	return ({
+		nw * ( 1.0 - u ) * ( 1.0 - v ) + ne * u * ( 1.0 - v )
+			+ sw * ( 1.0 - u ) * v + se * u * v,
+		( ne - nw ) * ( 1.0 - v ) + ( se - sw ) * v,
+		( sw - nw ) * ( 1.0 - u ) + ( se - ne ) * u
+	});
+}
+
+//--------------------------------------------------------------------------
+// Add amount to the four nodes around a position, split bilinearly
+//  (negative amounts erode).
+//
+private void erosion_spread( float *heights, int width, float posX, float posY, float amount )
+{
+	int nodeX = to_int( posX );
+	int nodeY = to_int( posY );
+	float u = posX - nodeX;
+	float v = posY - nodeY;
+	int i = nodeY * width + nodeX;
+
+	heights[i] += amount * ( 1.0 - u ) * ( 1.0 - v );
+	heights[i + 1] += amount * u * ( 1.0 - v );
+	heights[i + width] += amount * ( 1.0 - u ) * v;
+	heights[i + width + 1] += amount * u * v;
+}
+
+//--------------------------------------------------------------------------
+// Run one droplet from a start position inside the map.
+//
+private void erosion_droplet( float *heights, int width, int height, float posX, float posY )
+{
+	float dirX, dirY, speed, water, sediment;
+	float length, capacity, deltaHeight, amount;
+	float *here, *there;
+	int step;
+
+	dirX = 0.0;
+	dirY = 0.0;
+	speed = 1.0;
+	water = 1.0;
+	sediment = 0.0;
+
+	for( step = 0; step < EROSION_MAX_STEPS; step++ )
+	{
+		here = erosion_sample( heights, width, posX, posY );
+
+		dirX = dirX * EROSION_INERTIA - here[1] * ( 1.0 - EROSION_INERTIA );
+		dirY = dirY * EROSION_INERTIA - here[2] * ( 1.0 - EROSION_INERTIA );
+		length = sqrt( dirX * dirX + dirY * dirY );
+		if( length <= 0.0 )
+			break;
+		dirX /= length;
+		dirY /= length;
+
+		if( posX + dirX < 0.0 || posX + dirX >= width - 1
+			|| posY + dirY < 0.0 || posY + dirY >= height - 1 )
+			break;
+
+		there = erosion_sample( heights, width, posX + dirX, posY + dirY );
+		deltaHeight = there[0] - here[0];
+
+		capacity = -deltaHeight * speed * water * EROSION_CAPACITY;
+		if( capacity < EROSION_MIN_CAPACITY )
+			capacity = EROSION_MIN_CAPACITY;
+
+		if( deltaHeight > 0.0 || sediment > capacity )
+		{
+			// Uphill: fill the pit behind us; otherwise drop the excess
+			if( deltaHeight > 0.0 )
+				amount = deltaHeight < sediment ? deltaHeight : sediment;
+			else
+				amount = ( sediment - capacity ) * EROSION_DEPOSIT;
+			sediment -= amount;
+			erosion_spread( heights, width, posX, posY, amount );
+		}
+		else
+		{
+			// Never dig deeper than the drop we are about to take
+			amount = ( capacity - sediment ) * EROSION_ERODE;
+			if( amount > -deltaHeight )
+				amount = -deltaHeight;
+			sediment += amount;
+			erosion_spread( heights, width, posX, posY, -amount );
+		}
+
+		speed = speed * speed - deltaHeight * EROSION_GRAVITY;
+		speed = speed > 0.0 ? sqrt( speed ) : 0.0;
+		water *= 1.0 - EROSION_EVAPORATE;
+		posX += dirX;
+		posY += dirY;
+	}
+}
+
+//--------------------------------------------------------------------------
+void ErosionHydraulic( float *heights, int width, int height, int droplets, int seed )
+{
+	int droplet;
+
+	if( width < 2 || height < 2 )
+		return;
+
+	for( droplet = 0; droplet < droplets; droplet++ )
+		erosion_droplet( heights, width, height,
+			Get2dNoiseZeroToOne( droplet, 0, seed ) * ( width - 1.001 ),
+			Get2dNoiseZeroToOne( droplet, 1, seed ) * ( height - 1.001 ) );
+}
+
+//--------------------------------------------------------------------------
+// Droplets for a span x span map whose cell (0, 0) is world cell
+//  (originX, originY): every droplet block wholly inside the map, in world
+//  order.  A block gets perTile droplets per tileArea cells, the fraction
+//  decided by one more hash, so the density is right on average.
+//
+private void erosion_world_droplets( float *heights, int span, int originX, int originY, int perTile, int tileArea, int seed )
+{
+	int area = EROSION_DROP_BLOCK * EROSION_DROP_BLOCK;
+	int whole = perTile * area / tileArea;
+	float fraction = ( 1.0 * ( perTile * area % tileArea ) ) / tileArea;
+	int firstX = to_int( ceil( originX / ( 1.0 * EROSION_DROP_BLOCK ) ) );
+	int firstY = to_int( ceil( originY / ( 1.0 * EROSION_DROP_BLOCK ) ) );
+	int lastX = to_int( floor( ( originX + span ) / ( 1.0 * EROSION_DROP_BLOCK ) ) ) - 1;
+	int lastY = to_int( floor( ( originY + span ) / ( 1.0 * EROSION_DROP_BLOCK ) ) ) - 1;
+	float posX, posY;
+	int blockX, blockY, count, k;
+
+	for( blockY = firstY; blockY <= lastY; blockY++ )
+	{
+		for( blockX = firstX; blockX <= lastX; blockX++ )
+		{
+			count = whole + ( Get3dNoiseZeroToOne( blockX, blockY, -1, seed ) < fraction ? 1 : 0 );
+			for( k = 0; k < count; k++ )
+			{
+				posX = blockX * EROSION_DROP_BLOCK - originX
+					+ Get3dNoiseZeroToOne( blockX, blockY, 2 * k, seed ) * EROSION_DROP_BLOCK;
+				posY = blockY * EROSION_DROP_BLOCK - originY
+					+ Get3dNoiseZeroToOne( blockX, blockY, 2 * k + 1, seed ) * EROSION_DROP_BLOCK;
+				if( posX < span - 1.001 && posY < span - 1.001 )
+					erosion_droplet( heights, span, span, posX, posY );
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+private float *erosion_build_tile( int tileX, int tileY, int tileSize, float scale, int octaves, int droplets, int seed )
+{
+	int span = tileSize + 2 * EROSION_HALO;
+	int originX = tileX * tileSize - EROSION_HALO;
+	int originY = tileY * tileSize - EROSION_HALO;
+	float *heights;
+	float *tile = allocate( tileSize * tileSize, 0.0 );
+	int y;
+
+	heights = Get2dFbmGrid( originX, originY, span, span, scale, octaves, seed );
+
+	ErosionThermal( heights, span, span, EROSION_THERMAL_TALUS, EROSION_THERMAL_RATE, EROSION_THERMAL_STEPS );
+	erosion_world_droplets( heights, span, originX, originY, droplets, tileSize * tileSize, seed );
+
+	for( y = 0; y < tileSize; y++ )
+		tile[ y * tileSize .. y * tileSize + tileSize - 1 ] =
+			heights[ ( y + EROSION_HALO ) * span + EROSION_HALO
+				.. ( y + EROSION_HALO ) * span + EROSION_HALO + tileSize - 1 ];
+	return tile;
+}
+
+//--------------------------------------------------------------------------
+float *ErosionErodeTile( int tileX, int tileY, int tileSize, float scale, int octaves, int droplets, int seed )
+{
+	string key = TileCacheKey( sprintf( "erosion/%d/%d/%s/%d/%d", EROSION_HALO, tileSize,
+		TileCacheEncodeFloat( scale ), octaves, droplets ),
+		tileX, tileY, seed );
+
+	return TileCacheFetch( key,
+		(: erosion_build_tile, tileX, tileY, tileSize, scale, octaves, droplets, seed :) );
+}
+
+//--------------------------------------------------------------------------
+private void erosion_worker()
+{
+	mixed *job;
+
+	if( !sizeof( erosion_queue ) )
+		return;
+	job = erosion_queue[0];
+	erosion_queue = erosion_queue[1..];
+
+	// Schedule the next tile first so a failing callback can't stall the queue
+	if( sizeof( erosion_queue ) )
+		call_out( (: erosion_worker :), 0 );
+
+	evaluate( job[7], job[0], job[1],
+		ErosionErodeTile( job[0], job[1], job[2], job[3], job[4], job[5], job[6] ) );
+}
+
+//--------------------------------------------------------------------------
+void ErosionQueueTile( int tileX, int tileY, int tileSize, float scale, int octaves, int droplets, int seed, function callback )
+{
+	erosion_queue += ({ ({ tileX, tileY, tileSize, scale, octaves, droplets, seed, callback }) });
+	if( sizeof( erosion_queue ) == 1 )
+		call_out( (: erosion_worker :), 0 );
+}
+
+//--------------------------------------------------------------------------
+int ErosionQueueLength()
+{
+	return sizeof( erosion_queue );
+}
+
+#endif
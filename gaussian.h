@@ -0,0 +1,168 @@
+// gaussian.h
+// Normally distributed noise (mean 0, standard deviation 1)
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _GAUSSIAN_H
+#define _GAUSSIAN_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Gaussian noise
+//
+// Same random-access interface as Get*dNoise, but results follow a
+//  standard normal distribution; scale with mean + stddev * result.
+//
+// Each sample costs exactly one hash.  The 32 noise bits are read as a
+//  uniform u in (0,1) and pushed through the inverse normal CDF.  The top
+//  GAUSSIAN_TABLE_BITS bits pick a segment of a precomputed inverse-CDF
+//  table and the remaining bits interpolate linearly inside it.  The two
+//  outermost segments, where the curve bends too hard for a straight
+//  line, are evaluated directly with Acklam's rational approximation
+//  (relative error below 1.15e-9) instead.
+//
+// The table is built the first time it is needed.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define GAUSSIAN_TABLE_BITS     10
+#define GAUSSIAN_TABLE_SIZE     ( 1 << GAUSSIAN_TABLE_BITS )
+#define GAUSSIAN_FRACTION_BITS  ( 32 - GAUSSIAN_TABLE_BITS )
+
+//--------------------------------------------------------------------------
+// Map 32 noise bits to a standard normal value.  Exposed so other modules
+//  can reuse a hash they already have.
+//
+float NoiseBitsToGaussian( int bits );
+
+//--------------------------------------------------------------------------
+// Standard normal noise, random-access / deterministic.
+//
+float Get1dNoiseGaussian( int index, int seed );
+float Get2dNoiseGaussian( int posX, int posY, int seed );
+float Get3dNoiseGaussian( int posX, int posY, int posZ, int seed );
+float Get4dNoiseGaussian( int posX, int posY, int posZ, int posT, int seed );
+
+//--------------------------------------------------------------------------
+// Batch forms: count consecutive indices from startIndex, or a row-major
+//  grid of world cells (originX + x, originY + y).
+//
+float *Get1dNoiseGaussianBatch( int startIndex, int count, int seed );
+float *Get2dNoiseGaussianGrid( int originX, int originY, int width, int height, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+nosave private float *gaussian_table;
+
+//--------------------------------------------------------------------------
+// Inverse of the standard normal CDF for p in (0,1) (Peter Acklam's
+//  algorithm).
+//
+private float gaussian_inverse_cdf( float p )
+{
+	float q, r;
+
+	if( p < 0.02425 )
+	{
+		q = sqrt( -2.0 * log( p ) );
+		return ( ( ( ( ( -7.784894002430293e-03 * q - 3.223964580411365e-01 ) * q
+			- 2.400758277161838e+00 ) * q - 2.549732539343734e+00 ) * q
+			+ 4.374664141464968e+00 ) * q + 2.938163982698783e+00 )
+			/ ( ( ( ( 7.784695709041462e-03 * q + 3.224671290700398e-01 ) * q
+			+ 2.445134137142996e+00 ) * q + 3.754408661907416e+00 ) * q + 1.0 );
+	}
+	if( p > 1.0 - 0.02425 )
+		return -gaussian_inverse_cdf( 1.0 - p );
+
+	q = p - 0.5;
+	r = q * q;
+	return ( ( ( ( ( -3.969683028665376e+01 * r + 2.209460984245205e+02 ) * r
+		- 2.759285104469687e+02 ) * r + 1.383577518672690e+02 ) * r
+		- 3.066479806614716e+01 ) * r + 2.506628277459239e+00 ) * q
+		/ ( ( ( ( ( -5.447609879822406e+01 * r + 1.615858368580409e+02 ) * r
+		- 1.556989798598866e+02 ) * r + 6.680131188771972e+01 ) * r
+		- 1.328068155288572e+01 ) * r + 1.0 );
+}
+
+//--------------------------------------------------------------------------
+// Table entry i holds the inverse CDF at i / GAUSSIAN_TABLE_SIZE.  The end
+//  points are infinite and never read.
+//
+private void gaussian_build_table()
+{
+	int i;
+
+	gaussian_table = allocate( GAUSSIAN_TABLE_SIZE + 1, 0.0 );
+	for( i = 1; i < GAUSSIAN_TABLE_SIZE; i++ )
+		gaussian_table[i] = gaussian_inverse_cdf( ( 1.0 * i ) / GAUSSIAN_TABLE_SIZE );
+}
+
+//--------------------------------------------------------------------------
+float NoiseBitsToGaussian( int bits )
+{
+	int segment = bits >> GAUSSIAN_FRACTION_BITS;
+	float fraction;
+
+	if( !gaussian_table )
+		gaussian_build_table();
+
+	if( segment == 0 || segment == GAUSSIAN_TABLE_SIZE - 1 )
+		return gaussian_inverse_cdf( ( bits + 0.5 ) / ( 1.0 + INT_32_UNSIGNED_MAX ) );
+
+	fraction = ( 1.0 * ( bits & ( ( 1 << GAUSSIAN_FRACTION_BITS ) - 1 ) ) )
+		/ ( 1 << GAUSSIAN_FRACTION_BITS );
+	return gaussian_table[segment]
+		+ ( gaussian_table[segment + 1] - gaussian_table[segment] ) * fraction;
+}
+
+//--------------------------------------------------------------------------
+float Get1dNoiseGaussian( int index, int seed )
+{
+	return NoiseBitsToGaussian( Get1dNoise( index, seed ) );
+}
+
+//--------------------------------------------------------------------------
+float Get2dNoiseGaussian( int posX, int posY, int seed )
+{
+	return NoiseBitsToGaussian( Get2dNoise( posX, posY, seed ) );
+}
+
+//--------------------------------------------------------------------------
+float Get3dNoiseGaussian( int posX, int posY, int posZ, int seed )
+{
+	return NoiseBitsToGaussian( Get3dNoise( posX, posY, posZ, seed ) );
+}
+
+//--------------------------------------------------------------------------
+float Get4dNoiseGaussian( int posX, int posY, int posZ, int posT, int seed )
+{
+	return NoiseBitsToGaussian( Get4dNoise( posX, posY, posZ, posT, seed ) );
+}
+
+//--------------------------------------------------------------------------
+float *Get1dNoiseGaussianBatch( int startIndex, int count, int seed )
+{
+	float *result = allocate( count, 0.0 );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		result[i] = NoiseBitsToGaussian( Get1dNoise( startIndex + i, seed ) );
+	return result;
+}
+
+//--------------------------------------------------------------------------
+float *Get2dNoiseGaussianGrid( int originX, int originY, int width, int height, int seed )
+{
+	float *result = allocate( width * height, 0.0 );
+	int x, y;
+
+	for( y = 0; y < height; y++ )
+		for( x = 0; x < width; x++ )
+			result[ y * width + x ] = NoiseBitsToGaussian( Get2dNoise( originX + x, originY + y, seed ) );
+	return result;
+}
+
+#endif
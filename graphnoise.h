@@ -0,0 +1,197 @@
+// graphnoise.h
+// Deterministic noise on room graphs: per node, per edge and smoothed
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _GRAPHNOISE_H
+#define _GRAPHNOISE_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Graph noise
+//
+// Worlds made of rooms and exits are graphs, not grids.  Nodes are keyed by
+//  an integer room ID and hash with Get1dNoise.  Edges hash with
+//  Get2dNoise( lower ID, higher ID, seed ), so the exit from A to B and the
+//  one from B to A always get the same value; a per-direction value (e.g.
+//  uphill vs downhill) can still be had from Get2dNoise( from, to, seed ).
+//
+// For batch work the graph is packed once into adjacency arrays in
+//  compressed sparse row form:
+//
+//      ids         room ID of each node, ascending
+//      offsets     node n's neighbors are neighbors[offsets[n] .. offsets[n+1]-1]
+//      neighbors   node indices (not room IDs)
+//
+//  Values over the whole graph then come back as arrays indexed the same
+//  way: one per node, or one per neighbor slot for edges.
+//
+// Smoothing averages each node with its neighbors, repeated for the given
+//  number of iterations, so a value spreads about that many exits.  This
+//  gives region-scale effects (a haunted district, a damp cave system) that
+//  vary smoothly across connected rooms instead of per room.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Adjacency layout
+#define GRAPH_NOISE_IDS         0       // int *: room ID per node
+#define GRAPH_NOISE_OFFSETS     1       // int *: sizeof(ids) + 1 entries
+#define GRAPH_NOISE_NEIGHBORS   2       // int *: neighbor node indices
+
+//--------------------------------------------------------------------------
+// Single values.
+//
+int GetNodeNoise( int node, int seed );
+float GetNodeNoiseZeroToOne( int node, int seed );
+int GetEdgeNoise( int nodeA, int nodeB, int seed );
+float GetEdgeNoiseZeroToOne( int nodeA, int nodeB, int seed );
+
+//--------------------------------------------------------------------------
+// Pack ([ room ID : ({ neighbor room IDs }) ]) into adjacency arrays.
+//  Exits to rooms missing from the mapping are dropped, and one-way exits
+//  are kept one-way.
+//
+mixed *GraphNoiseAdjacency( mapping exits );
+
+//--------------------------------------------------------------------------
+// Batch values, in [0, 1].  GraphEdgeCosts maps each neighbor slot's edge
+//  value into [minCost, maxCost].
+//
+float *GraphNodeValues( mixed *adjacency, int seed );
+float *GraphSmoothValues( mixed *adjacency, float *values, int iterations );
+float *GraphSmoothedNoise( mixed *adjacency, int iterations, int seed );
+float *GraphEdgeCosts( mixed *adjacency, float minCost, float maxCost, int seed );
+
+//--------------------------------------------------------------------------
+// Total cost of walking a path of room IDs, with edge costs as above.
+//
+float GraphPathCost( int *path, float minCost, float maxCost, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+int GetNodeNoise( int node, int seed )
+{
+	return Get1dNoise( node, seed );
+}
+
+//--------------------------------------------------------------------------
+float GetNodeNoiseZeroToOne( int node, int seed )
+{
+	return Get1dNoiseZeroToOne( node, seed );
+}
+
+//--------------------------------------------------------------------------
+int GetEdgeNoise( int nodeA, int nodeB, int seed )
+{
+	return nodeA < nodeB ? Get2dNoise( nodeA, nodeB, seed ) : Get2dNoise( nodeB, nodeA, seed );
+}
+
+//--------------------------------------------------------------------------
+float GetEdgeNoiseZeroToOne( int nodeA, int nodeB, int seed )
+{
+	return nodeA < nodeB ? Get2dNoiseZeroToOne( nodeA, nodeB, seed )
+		: Get2dNoiseZeroToOne( nodeB, nodeA, seed );
+}
+
+//--------------------------------------------------------------------------
+mixed *GraphNoiseAdjacency( mapping exits )
+{
+	int *ids = sort_array( keys( exits ), 1 );
+	int *offsets = allocate( sizeof( ids ) + 1 );
+	int *neighbors = ({});
+	mapping indexOf = ([]);
+	int i, room;
+
+	for( i = 0; i < sizeof( ids ); i++ )
+		indexOf[ ids[i] ] = i;
+
+	for( i = 0; i < sizeof( ids ); i++ )
+	{
+		offsets[i] = sizeof( neighbors );
+		foreach( room in exits[ ids[i] ] )
+			if( !undefinedp( indexOf[room] ) )
+				neighbors += ({ indexOf[room] });
+	}
+	offsets[<1] = sizeof( neighbors );
+
+	return ({ ids, offsets, neighbors });
+}
+
+//--------------------------------------------------------------------------
+float *GraphNodeValues( mixed *adjacency, int seed )
+{
+	int *ids = adjacency[GRAPH_NOISE_IDS];
+	float *values = allocate( sizeof( ids ), 0.0 );
+	int i;
+
+	for( i = 0; i < sizeof( ids ); i++ )
+		values[i] = Get1dNoiseZeroToOne( ids[i], seed );
+	return values;
+}
+
+//--------------------------------------------------------------------------
+float *GraphSmoothValues( mixed *adjacency, float *values, int iterations )
+{
+	int *offsets = adjacency[GRAPH_NOISE_OFFSETS];
+	int *neighbors = adjacency[GRAPH_NOISE_NEIGHBORS];
+	int count = sizeof( values );
+	float *next;
+	float total;
+	int pass, node, slot;
+
+	// Each pass reads only the previous pass, so the result does not depend
+	//  on node order
+	for( pass = 0; pass < iterations; pass++ )
+	{
+		next = allocate( count, 0.0 );
+		for( node = 0; node < count; node++ )
+		{
+			total = values[node];
+			for( slot = offsets[node]; slot < offsets[ node + 1 ]; slot++ )
+				total += values[ neighbors[slot] ];
+			next[node] = total / ( 1 + offsets[ node + 1 ] - offsets[node] );
+		}
+		values = next;
+	}
+	return values;
+}
+
+//--------------------------------------------------------------------------
+float *GraphSmoothedNoise( mixed *adjacency, int iterations, int seed )
+{
+	return GraphSmoothValues( adjacency, GraphNodeValues( adjacency, seed ), iterations );
+}
+
+//--------------------------------------------------------------------------
+float *GraphEdgeCosts( mixed *adjacency, float minCost, float maxCost, int seed )
+{
+	int *ids = adjacency[GRAPH_NOISE_IDS];
+	int *offsets = adjacency[GRAPH_NOISE_OFFSETS];
+	int *neighbors = adjacency[GRAPH_NOISE_NEIGHBORS];
+	float *costs = allocate( sizeof( neighbors ), 0.0 );
+	float range = maxCost - minCost;
+	int node, slot;
+
+	for( node = 0; node < sizeof( ids ); node++ )
+		for( slot = offsets[node]; slot < offsets[ node + 1 ]; slot++ )
+			costs[slot] = minCost + range * GetEdgeNoiseZeroToOne( ids[node], ids[ neighbors[slot] ], seed );
+	return costs;
+}
+
+//--------------------------------------------------------------------------
+float GraphPathCost( int *path, float minCost, float maxCost, int seed )
+{
+	float range = maxCost - minCost;
+	float total = 0.0;
+	int i;
+
+	for( i = 1; i < sizeof( path ); i++ )
+		total += minCost + range * GetEdgeNoiseZeroToOne( path[ i - 1 ], path[i], seed );
+	return total;
+}
+
+#endif
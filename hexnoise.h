@@ -0,0 +1,314 @@
+// hexnoise.h
+// Noise on hex grids in axial coordinates
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _HEXNOISE_H
+#define _HEXNOISE_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Hex noise
+//
+// Hexes are addressed by axial coordinates (q, r), with the third cube
+//  coordinate s = -q - r implied.  The six neighbors of a hex are at
+//  (q+1, r), (q+1, r-1), (q, r-1), (q-1, r), (q-1, r+1) and (q, r+1).
+//
+// Raw noise is keyed directly by (q, r), so nobody has to convert to
+//  offset coordinates first and every map layout sees the same values.
+//
+// Hex value noise is sampled at fractional axial positions.  Hex centers
+//  form a triangular lattice, and every point lies in a triangle of three
+//  mutually adjacent centers: in the (q0, r0) parallelogram cell, either
+//  {(q0, r0), (q0+1, r0), (q0, r0+1)} or {(q0+1, r0+1), (q0, r0+1),
+//  (q0+1, r0)}.  The value is a blend of those three lattice values, with
+//  smoothstepped barycentric weights so the result has no visible creases
+//  along triangle edges.  This costs three hashes per sample instead of
+//  the four a square grid needs.
+//
+// Batch forms fill offset-coordinate rectangles ("odd-r" layout: odd rows
+//  shifted right, col = q + (r - (r & 1)) / 2) row by row, and rings or
+//  filled spirals around a center in one call.  Rings start at the
+//  (q - radius, r + radius) corner and walk around counter-clockwise;
+//  spirals are the center followed by rings 1..radius.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Coordinate list layout
+#define HEX_LIST_Q              0       // int *
+#define HEX_LIST_R              1       // int *
+
+//--------------------------------------------------------------------------
+// Raw noise at a hex.
+//
+int GetHexNoise( int q, int r, int seed );
+float GetHexNoiseZeroToOne( int q, int r, int seed );
+float GetHexNoiseNegOneToOne( int q, int r, int seed );
+
+//--------------------------------------------------------------------------
+// Coherent noise at fractional axial positions, in [-1, 1].
+//
+float GetHexValueNoise( float posQ, float posR, int seed );
+float GetHexFbm( float posQ, float posR, int octaves, int seed );
+
+//--------------------------------------------------------------------------
+// Coordinate helpers.  HexRound returns ({ q, r }) of the hex containing a
+//  fractional axial position.
+//
+int *HexRound( float posQ, float posR );
+int *HexOffsetToAxial( int col, int row );
+int *HexAxialToOffset( int q, int r );
+int HexDistance( int q1, int r1, int q2, int r2 );
+mixed *HexRing( int q, int r, int radius );
+mixed *HexSpiral( int q, int r, int radius );
+
+//--------------------------------------------------------------------------
+// Batch fills.  Rectangles are width x height hexes in offset coordinates
+//  from (col, row), row-major; rings and spirals are in HexRing/HexSpiral
+//  order.  Hex fBm samples each hex center at (q / scale, r / scale).
+//
+int *GetHexNoiseRect( int col, int row, int width, int height, int seed );
+float *GetHexFbmRect( int col, int row, int width, int height, float scale, int octaves, int seed );
+int *GetHexNoiseRing( int q, int r, int radius, int seed );
+int *GetHexNoiseSpiral( int q, int r, int radius, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+int GetHexNoise( int q, int r, int seed )
+{
+	return SquirrelNoise5( NOISE_MIX_2D( q, r ), seed );
+}
+
+//--------------------------------------------------------------------------
+float GetHexNoiseZeroToOne( int q, int r, int seed )
+{
+	return Get2dNoiseZeroToOne( q, r, seed );
+}
+
+//--------------------------------------------------------------------------
+float GetHexNoiseNegOneToOne( int q, int r, int seed )
+{
+	return Get2dNoiseNegOneToOne( q, r, seed );
+}
+
+//--------------------------------------------------------------------------
+private float hex_smoothstep( float t )
+{
+	return t * t * ( 3.0 - 2.0 * t );
+}
+
+//--------------------------------------------------------------------------
+float GetHexValueNoise( float posQ, float posR, int seed )
+{
+	int q0 = to_int( floor( posQ ) );
+	int r0 = to_int( floor( posR ) );
+	float fq = posQ - q0;
+	float fr = posR - r0;
+	float w0, w1, w2;
+	float v0, v1, v2;
+
+	// Pick the triangle and its linear barycentric weights
+	if( fq + fr < 1.0 )
+	{
+		v0 = Get2dNoiseNegOneToOne( q0, r0, seed );
+		w0 = 1.0 - fq - fr;
+		w1 = fq;
+		w2 = fr;
+	}
+	else
+	{
+		v0 = Get2dNoiseNegOneToOne( q0 + 1, r0 + 1, seed );
+		w0 = fq + fr - 1.0;
+		w1 = 1.0 - fr;
+		w2 = 1.0 - fq;
+	}
+	v1 = Get2dNoiseNegOneToOne( q0 + 1, r0, seed );
+	v2 = Get2dNoiseNegOneToOne( q0, r0 + 1, seed );
+
+	// Smooth the weights and renormalize; a weight that is zero on an edge
+	//  stays zero, so neighboring triangles agree along it
+	w0 = hex_smoothstep( w0 );
+	w1 = hex_smoothstep( w1 );
+	w2 = hex_smoothstep( w2 );
+	return ( w0 * v0 + w1 * v1 + w2 * v2 ) / ( w0 + w1 + w2 );
+}
+
+//--------------------------------------------------------------------------
+float GetHexFbm( float posQ, float posR, int octaves, int seed )
+{
+	float total = 0.0;
+	float amplitude = 1.0;
+	float range = 0.0;
+	int octave;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		total += amplitude * GetHexValueNoise( posQ, posR, seed + octave );
+		range += amplitude;
+		posQ *= 2.0;
+		posR *= 2.0;
+		amplitude *= 0.5;
+	}
+	return range > 0.0 ? total / range : 0.0;
+}
+
+//--------------------------------------------------------------------------
+int *HexRound( float posQ, float posR )
+{
+	float posS = -posQ - posR;
+	int q = to_int( floor( posQ + 0.5 ) );
+	int r = to_int( floor( posR + 0.5 ) );
+	int s = to_int( floor( posS + 0.5 ) );
+	float dq = abs( q - posQ );
+	float dr = abs( r - posR );
+	float ds = abs( s - posS );
+
+	// Rounding can break q + r + s == 0; fix the coordinate that moved most
+	if( dq > dr && dq > ds )
+		q = -r - s;
+	else if( dr > ds )
+		r = -q - s;
+	return ({ q, r });
+}
+
+//--------------------------------------------------------------------------
+int *HexOffsetToAxial( int col, int row )
+{
+	return ({ col - ( row - ( row & 1 ) ) / 2, row });
+}
+
+//--------------------------------------------------------------------------
+int *HexAxialToOffset( int q, int r )
+{
+	return ({ q + ( r - ( r & 1 ) ) / 2, r });
+}
+
+//--------------------------------------------------------------------------
+int HexDistance( int q1, int r1, int q2, int r2 )
+{
+	int dq = abs( q1 - q2 );
+	int dr = abs( r1 - r2 );
+	int ds = abs( q1 + r1 - q2 - r2 );
+
+	return dq > dr ? ( dq > ds ? dq : ds ) : ( dr > ds ? dr : ds );
+}
+
+//--------------------------------------------------------------------------
+// Appends ring `radius` around (q, r) to the lists, starting at index at.
+//
+private void hex_ring_into( int *qs, int *rs, int at, int q, int r, int radius )
+{
+	int *stepQ = ({ 1, 1, 0, -1, -1, 0 });
+	int *stepR = ({ 0, -1, -1, 0, 1, 1 });
+	int side, i;
+
+	if( !radius )
+	{
+		qs[at] = q;
+		rs[at] = r;
+		return;
+	}
+
+	q -= radius;
+	r += radius;
+	for( side = 0; side < 6; side++ )
+	{
+		for( i = 0; i < radius; i++ )
+		{
+			qs[at] = q;
+			rs[at] = r;
+			at++;
+			q += stepQ[side];
+			r += stepR[side];
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+mixed *HexRing( int q, int r, int radius )
+{
+	int count = radius ? 6 * radius : 1;
+	int *qs = allocate( count );
+	int *rs = allocate( count );
+
+	hex_ring_into( qs, rs, 0, q, r, radius );
+	return ({ qs, rs });
+}
+
+//--------------------------------------------------------------------------
+mixed *HexSpiral( int q, int r, int radius )
+{
+	int count = 1 + 3 * radius * ( radius + 1 );
+	int *qs = allocate( count );
+	int *rs = allocate( count );
+	int ring;
+
+	for( ring = 0; ring <= radius; ring++ )
+		hex_ring_into( qs, rs, ring ? 1 + 3 * ring * ( ring - 1 ) : 0, q, r, ring );
+	return ({ qs, rs });
+}
+
+//--------------------------------------------------------------------------
+int *GetHexNoiseRect( int col, int row, int width, int height, int seed )
+{
+	int *values = allocate( width * height );
+	int x, y, r, base;
+
+	for( y = 0; y < height; y++ )
+	{
+		// The mixed index is linear in q along a row
+		r = row + y;
+		base = NOISE_MIX_2D( col - ( r - ( r & 1 ) ) / 2, r );
+		for( x = 0; x < width; x++ )
+			values[ y * width + x ] = SquirrelNoise5( base + x, seed );
+	}
+	return values;
+}
+
+//--------------------------------------------------------------------------
+float *GetHexFbmRect( int col, int row, int width, int height, float scale, int octaves, int seed )
+{
+	float *values = allocate( width * height, 0.0 );
+	float frequency = 1.0 / scale;
+	int x, y, q, r;
+
+	for( y = 0; y < height; y++ )
+	{
+		r = row + y;
+		q = col - ( r - ( r & 1 ) ) / 2;
+		for( x = 0; x < width; x++ )
+			values[ y * width + x ] = GetHexFbm( ( q + x ) * frequency, r * frequency, octaves, seed );
+	}
+	return values;
+}
+
+//--------------------------------------------------------------------------
+private int *hex_noise_list( mixed *hexes, int seed )
+{
+	int *qs = hexes[HEX_LIST_Q];
+	int *rs = hexes[HEX_LIST_R];
+	int *values = allocate( sizeof( qs ) );
+	int i;
+
+	for( i = 0; i < sizeof( qs ); i++ )
+		values[i] = SquirrelNoise5( NOISE_MIX_2D( qs[i], rs[i] ), seed );
+	return values;
+}
+
+//--------------------------------------------------------------------------
+int *GetHexNoiseRing( int q, int r, int radius, int seed )
+{
+	return hex_noise_list( HexRing( q, r, radius ), seed );
+}
+
+//--------------------------------------------------------------------------
+int *GetHexNoiseSpiral( int q, int r, int radius, int seed )
+{
+	return hex_noise_list( HexSpiral( q, r, radius ), seed );
+}
+
+#endif
@@ -0,0 +1,322 @@
+// loot.h
+// Nested loot tables compiled to alias samplers
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _LOOT_H
+#define _LOOT_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Loot tables
+//
+// A loot table is an array of entries ({ weight, result, minQty, maxQty }).
+//  The result is an item name, 0 for "nothing", or another loot table,
+//  which is rolled in turn (its quantities are then ignored).  Weights are
+//  relative and need not add up to anything.
+//
+//	({
+//	  ({ 70, 0 }),
+//	  ({ 25, "gold coin", 5, 20 }),
+//	  ({ 5, ({ ({ 9, "ruby" }), ({ 1, "star sapphire" }) }) }),
+//	})
+//
+// LootCompile flattens the nesting into numbered nodes and builds a Vose
+//  alias table for each, so picking an entry is constant time no matter how
+//  many entries a table has.  One hash picks both the alias column (high
+//  part of hash * entries) and the alias coin (the low 32 bits of the same
+//  product), so each level of nesting costs a single hash.
+//
+// Rolls are a pure function of (kill ID, seed): roll r of a kill draws its
+//  hashes from Get3dNoise( killId, r, step, seed ).
+//
+// Simulation results are plain counts, so results for separate ranges of
+//  kill IDs merge exactly with LootMergeResults.  A million-kill drop rate
+//  check is too much for one call; LootSimulateAsync runs it a chunk of
+//  kills per call_out and gives the same totals as a single LootSimulate.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define LOOT_MAX_DEPTH          16      // Guards against self-referencing tables
+#define LOOT_DEFAULT_CHUNK      2000    // Kills per call_out in LootSimulateAsync
+
+// Compiled table layout
+#define LOOT_ITEMS              0       // string *: item names, by item ID
+#define LOOT_NODES              1       // ({ node, ... }), node 0 is the root
+
+// Node layout
+#define LOOT_NODE_THRESHOLD     0       // int *: alias coin thresholds (of 2^32)
+#define LOOT_NODE_ALIAS         1       // int *: alias column per column
+#define LOOT_NODE_ITEM          2       // int *: item ID, -1 for nothing, or -2 - node for a subtable
+#define LOOT_NODE_MIN_QTY       3       // int *
+#define LOOT_NODE_MAX_QTY       4       // int *
+
+#define LOOT_NOTHING            -1
+
+//--------------------------------------------------------------------------
+// Compile a nested table.
+//
+mixed *LootCompile( mixed *table );
+
+//--------------------------------------------------------------------------
+// Roll a compiled table rolls times for one kill; returns
+//  ([ item : quantity ]).
+//
+mapping LootRoll( mixed *compiled, int killId, int rolls, int seed );
+
+//--------------------------------------------------------------------------
+// Roll kills consecutive kill IDs from firstKill and total the results:
+//  ([ item : ({ times dropped, total quantity }) ]).  Meant for checking
+//  drop rates.
+//
+mapping LootSimulate( mixed *compiled, int firstKill, int kills, int rolls, int seed );
+mapping LootMergeResults( mapping a, mapping b );
+
+//--------------------------------------------------------------------------
+// Simulate kills chunk by chunk over call_outs, then call
+//  callback( result ).  chunk 0 means LOOT_DEFAULT_CHUNK.
+//
+void LootSimulateAsync( mixed *compiled, int firstKill, int kills, int rolls, int seed, int chunk, function callback );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+// Vose's alias method.  Returns ({ thresholds, aliases }) with thresholds
+//  scaled so that a 32-bit coin below the threshold keeps the column.
+//
+private mixed *loot_build_alias( float *weights )
+{
+	int count = sizeof( weights );
+	float *scaled = allocate( count, 0.0 );
+	int *thresholds = allocate( count );
+	int *aliases = allocate( count );
+	int *small = ({});
+	int *large = ({});
+	float total = 0.0;
+	int i, less, more;
+
+	for( i = 0; i < count; i++ )
+		total += weights[i];
+	for( i = 0; i < count; i++ )
+	{
+		scaled[i] = total > 0.0 ? weights[i] * count / total : 1.0;
+		aliases[i] = i;
+		if( scaled[i] < 1.0 )
+			small += ({ i });
+		else
+			large += ({ i });
+	}
+
+	while( sizeof( small ) && sizeof( large ) )
+	{
+		less = small[<1];
+		small = small[0 .. <2];
+		more = large[<1];
+		large = large[0 .. <2];
+
+		thresholds[less] = to_int( scaled[less] * ( 1.0 + INT_32_UNSIGNED_MAX ) );
+		aliases[less] = more;
+		scaled[more] -= 1.0 - scaled[less];
+		if( scaled[more] < 1.0 )
+			small += ({ more });
+		else
+			large += ({ more });
+	}
+
+	// Whatever is left is full up to rounding error
+	foreach( i in small + large )
+		thresholds[i] = INT_32_UNSIGNED_MAX + 1;
+
+	return ({ thresholds, aliases });
+}
+
+//--------------------------------------------------------------------------
+// Compile one table into nodes (appending to the shared lists) and return
+//  its node number.
+//
+private int loot_compile_node( mixed *table, string *items, mixed *nodes, mapping itemIds, int depth )
+{
+	int node = sizeof( nodes[0] );
+	int count = sizeof( table );
+	float *weights = allocate( count, 0.0 );
+	int *targets = allocate( count );
+	int *minQty = allocate( count );
+	int *maxQty = allocate( count );
+	mixed *entry, *alias;
+	int i;
+
+	if( depth > LOOT_MAX_DEPTH )
+		error( "LootCompile: tables nested too deeply\n" );
+
+	// Reserve the slot first so subtables number after their parent
+	nodes[0] += ({ 0 });
+
+	for( i = 0; i < count; i++ )
+	{
+		entry = table[i];
+		weights[i] = 1.0 * entry[0];
+		minQty[i] = sizeof( entry ) > 2 ? entry[2] : 1;
+		maxQty[i] = sizeof( entry ) > 3 ? entry[3] : minQty[i];
+		if( arrayp( entry[1] ) )
+			targets[i] = -2 - loot_compile_node( entry[1], items, nodes, itemIds, depth + 1 );
+		else if( stringp( entry[1] ) )
+		{
+			if( undefinedp( itemIds[ entry[1] ] ) )
+			{
+				itemIds[ entry[1] ] = sizeof( items[0] );
+				items[0] += ({ entry[1] });
+			}
+			targets[i] = itemIds[ entry[1] ];
+		}
+		else
+			targets[i] = LOOT_NOTHING;
+	}
+
+	alias = loot_build_alias( weights );
+	nodes[0][node] = ({ alias[0], alias[1], targets, minQty, maxQty });
+	return node;
+}
+
+//--------------------------------------------------------------------------
+mixed *LootCompile( mixed *table )
+{
+	// One-element wrappers so the recursion can append in place
+	mixed *items = ({ ({}) });
+	mixed *nodes = ({ ({}) });
+
+	loot_compile_node( table, items, nodes, ([]), 0 );
+	return ({ items[0], nodes[0] });
+}
+
+//--------------------------------------------------------------------------
+// Roll once: returns ({ item ID, quantity }), item ID LOOT_NOTHING for
+//  nothing.
+//
+private int *loot_roll_once( mixed *nodes, int killId, int roll, int seed )
+{
+	mixed *node = nodes[0];
+	int step = 0;
+	int bits, product, column, target, span;
+
+	while( 1 )
+	{
+		if( !sizeof( node[LOOT_NODE_ITEM] ) || step > LOOT_MAX_DEPTH )
+			return ({ LOOT_NOTHING, 0 });
+
+		bits = Get3dNoise( killId, roll, step++, seed );
+		product = bits * sizeof( node[LOOT_NODE_ITEM] );
+		column = product >> 32;
+		if( ( product & INT_32_UNSIGNED_MAX ) >= node[LOOT_NODE_THRESHOLD][column] )
+			column = node[LOOT_NODE_ALIAS][column];
+
+		target = node[LOOT_NODE_ITEM][column];
+		if( target <= -2 )
+		{
+			node = nodes[ -2 - target ];
+			continue;
+		}
+		if( target == LOOT_NOTHING )
+			return ({ LOOT_NOTHING, 0 });
+
+		span = node[LOOT_NODE_MAX_QTY][column] - node[LOOT_NODE_MIN_QTY][column] + 1;
+		if( span <= 1 )
+			return ({ target, node[LOOT_NODE_MIN_QTY][column] });
+		return ({ target, node[LOOT_NODE_MIN_QTY][column]
+			+ Get3dNoise( killId, roll, step, seed ) % span });
+	}
+}
+
+//--------------------------------------------------------------------------
+mapping LootRoll( mixed *compiled, int killId, int rolls, int seed )
+{
+	mapping result = ([]);
+	int *drop;
+	int roll;
+
+	for( roll = 0; roll < rolls; roll++ )
+	{
+		drop = loot_roll_once( compiled[LOOT_NODES], killId, roll, seed );
+		if( drop[0] != LOOT_NOTHING )
+			result[ compiled[LOOT_ITEMS][ drop[0] ] ] += drop[1];
+	}
+	return result;
+}
+
+//--------------------------------------------------------------------------
+mapping LootSimulate( mixed *compiled, int firstKill, int kills, int rolls, int seed )
+{
+	int itemCount = sizeof( compiled[LOOT_ITEMS] );
+	int *drops = allocate( itemCount );
+	int *quantities = allocate( itemCount );
+	mapping result = ([]);
+	int *drop;
+	int kill, roll, i;
+
+	// Tally by item ID; names are only attached at the end
+	for( kill = firstKill; kill < firstKill + kills; kill++ )
+	{
+		for( roll = 0; roll < rolls; roll++ )
+		{
+			drop = loot_roll_once( compiled[LOOT_NODES], kill, roll, seed );
+			if( drop[0] == LOOT_NOTHING )
+				continue;
+			drops[ drop[0] ]++;
+			quantities[ drop[0] ] += drop[1];
+		}
+	}
+
+	for( i = 0; i < itemCount; i++ )
+		result[ compiled[LOOT_ITEMS][i] ] = ({ drops[i], quantities[i] });
+	return result;
+}
+
+//--------------------------------------------------------------------------
+mapping LootMergeResults( mapping a, mapping b )
+{
+	mapping result = ([]);
+	string item;
+
+	foreach( item in keys( a ) )
+		result[item] = ({ a[item][0], a[item][1] });
+	foreach( item in keys( b ) )
+	{
+		if( result[item] )
+			result[item] = ({ result[item][0] + b[item][0], result[item][1] + b[item][1] });
+		else
+			result[item] = ({ b[item][0], b[item][1] });
+	}
+	return result;
+}
+
+//--------------------------------------------------------------------------
+private void loot_async_step( mixed *compiled, int next, int end, int rolls, int seed, int chunk, function callback, mapping result )
+{
+	int count = end - next < chunk ? end - next : chunk;
+
+	result = LootMergeResults( result, LootSimulate( compiled, next, count, rolls, seed ) );
+	next += count;
+
+	if( next < end )
+		call_out( (: loot_async_step :), 0, compiled, next, end, rolls, seed, chunk, callback, result );
+	else
+		evaluate( callback, result );
+}
+
+//--------------------------------------------------------------------------
+void LootSimulateAsync( mixed *compiled, int firstKill, int kills, int rolls, int seed, int chunk, function callback )
+{
+	if( chunk <= 0 )
+		chunk = LOOT_DEFAULT_CHUNK;
+	if( kills <= 0 )
+	{
+		evaluate( callback, LootSimulate( compiled, firstKill, 0, rolls, seed ) );
+		return;
+	}
+	call_out( (: loot_async_step :), 0, compiled, firstKill, firstKill + kills, rolls, seed,
+		chunk, callback, ([]) );
+}
+
+#endif
@@ -0,0 +1,382 @@
+// maze.h
+// Deterministic maze and room-and-corridor layouts
+// Built on noise.h (SquirrelNoise5) and cellular.h (packed bitmaps)
+
+#ifndef _MAZE_H
+#define _MAZE_H
+
+#include "noise.h"
+#include "cellular.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Maze and dungeon layouts
+//
+// Every choice is drawn from Get3dNoise keyed by block position and a step
+//  counter, so a layout is a pure function of its dimensions and seed.
+//
+// Layouts are split into square blocks.  Each block is carved on its own
+//  (an iterative backtracker for mazes, a single room for dungeons), and
+//  blocks are joined into a spanning tree where every block links either
+//  north or east (a binary tree, decided by one hash per block).  Since
+//  both the block contents and the links only depend on the block
+//  coordinates, any sub-region can be generated on demand by carving just
+//  the blocks it overlaps, and it will match the same region of the full
+//  layout exactly.  The result is still a perfect maze: one path between
+//  any two cells.
+//
+// Wall bitsets use the packed bitmap layout from cellular.h (set bit is a
+//  wall).  Rows run north (y = 0) to south.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define MAZE_BLOCK_SIZE         16      // Maze cells per block edge
+#define DUNGEON_BLOCK_SIZE      12      // Dungeon tiles per block edge
+#define DUNGEON_MIN_ROOM        3       // Smallest room edge, in tiles
+
+#define MAZE_LINK_NONE          0
+#define MAZE_LINK_NORTH         1
+#define MAZE_LINK_EAST          2
+
+#define MAZE_OPEN_EAST          1
+#define MAZE_OPEN_SOUTH         2
+
+// posZ values reserved for per-block decisions (backtracker steps count up
+//  from zero, so these never collide)
+#define MAZE_SALT_LINK          -1
+#define MAZE_SALT_DOOR          -2
+#define MAZE_SALT_START         -3
+#define MAZE_SALT_ROOM_W        -4
+#define MAZE_SALT_ROOM_H        -5
+#define MAZE_SALT_ROOM_X        -6
+#define MAZE_SALT_ROOM_Y        -7
+#define MAZE_SALT_BEND          -8
+
+//--------------------------------------------------------------------------
+// Perfect maze of mazeWidth x mazeHeight cells.  Returns
+//  ({ eastWalls, southWalls }), two width x height bitsets for the cells
+//  starting at (originX, originY): bit set means the wall on that side of
+//  the cell is closed.  Cells outside the maze are closed on all sides.
+//
+mixed *MazeGenerateRegion( int originX, int originY, int width, int height, int mazeWidth, int mazeHeight, int seed );
+
+//--------------------------------------------------------------------------
+// Same maze, rendered as a (2 * width + 1) x (2 * height + 1) tile bitmap
+//  (walls and pillars set, floors clear).  Tile (2i + 1, 2j + 1) is the
+//  cell (originX + i, originY + j).
+//
+int *MazeGenerateTiles( int originX, int originY, int width, int height, int mazeWidth, int mazeHeight, int seed );
+
+//--------------------------------------------------------------------------
+// Room-and-corridor dungeon of roomsWide x roomsHigh blocks, one room per
+//  block, rendered as a width x height tile bitmap starting at tile
+//  (originX, originY).  Tiles outside the dungeon are wall.
+//
+int *DungeonGenerateTiles( int originX, int originY, int width, int height, int roomsWide, int roomsHigh, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+// Which neighbor block this block links to in the spanning tree.  The top
+//  row can only link east, the last column only north, and the top-right
+//  block is the root.
+//
+private int maze_block_link( int blockX, int blockY, int blocksWide, int seed )
+{
+	if( blockY == 0 && blockX == blocksWide - 1 )
+		return MAZE_LINK_NONE;
+	if( blockY == 0 )
+		return MAZE_LINK_EAST;
+	if( blockX == blocksWide - 1 )
+		return MAZE_LINK_NORTH;
+	return ( Get3dNoise( blockX, blockY, MAZE_SALT_LINK, seed ) & 1 )
+		? MAZE_LINK_NORTH : MAZE_LINK_EAST;
+}
+
+//--------------------------------------------------------------------------
+// Size of a block along one axis; the last block may be partial.
+//
+private int maze_block_span( int block, int blockSize, int total )
+{
+	int span = total - block * blockSize;
+	return span < blockSize ? span : blockSize;
+}
+
+//--------------------------------------------------------------------------
+// Carve one block of the maze with an iterative backtracker.  Returns
+//  MAZE_OPEN_* flags per cell (row-major within the block).
+//
+private int *maze_carve_block( int blockX, int blockY, int blockW, int blockH, int seed )
+{
+	int cells = blockW * blockH;
+	int *open = allocate( cells );
+	int *visited = allocate( cells );
+	int *stack = allocate( cells );
+	int *candidates = allocate( 4 );
+	int top = 0;
+	int step = 0;
+	int cell, next, cellX, cellY, count;
+
+	cell = Get3dNoise( blockX, blockY, MAZE_SALT_START, seed ) % cells;
+	visited[cell] = 1;
+	stack[top++] = cell;
+
+	while( top > 0 )
+	{
+		cell = stack[top - 1];
+		cellX = cell % blockW;
+		cellY = cell / blockW;
+		count = 0;
+		if( cellX > 0 && !visited[cell - 1] )
+			candidates[count++] = cell - 1;
+		if( cellX < blockW - 1 && !visited[cell + 1] )
+			candidates[count++] = cell + 1;
+		if( cellY > 0 && !visited[cell - blockW] )
+			candidates[count++] = cell - blockW;
+		if( cellY < blockH - 1 && !visited[cell + blockW] )
+			candidates[count++] = cell + blockW;
+
+		if( !count )
+		{
+			top--;
+			continue;
+		}
+
+		next = candidates[ Get3dNoise( blockX, blockY, step++, seed ) % count ];
+		if( next == cell + 1 )
+			open[cell] |= MAZE_OPEN_EAST;
+		else if( next == cell - 1 )
+			open[next] |= MAZE_OPEN_EAST;
+		else if( next == cell + blockW )
+			open[cell] |= MAZE_OPEN_SOUTH;
+		else
+			open[next] |= MAZE_OPEN_SOUTH;
+
+		visited[next] = 1;
+		stack[top++] = next;
+	}
+	return open;
+}
+
+//--------------------------------------------------------------------------
+private void maze_set_bit( int *bitmap, int rowWords, int posX, int posY )
+{
+	bitmap[ posY * rowWords + posX / CA_BITS_PER_WORD ] |= 1 << ( posX % CA_BITS_PER_WORD );
+}
+
+//--------------------------------------------------------------------------
+mixed *MazeGenerateRegion( int originX, int originY, int width, int height, int mazeWidth, int mazeHeight, int seed )
+{
+	int rowWords = CaRowWords( width );
+	int *eastWalls = allocate( rowWords * height );
+	int *southWalls = allocate( rowWords * height );
+	int blocksWide = ( mazeWidth + MAZE_BLOCK_SIZE - 1 ) / MAZE_BLOCK_SIZE;
+	int blocksHigh = ( mazeHeight + MAZE_BLOCK_SIZE - 1 ) / MAZE_BLOCK_SIZE;
+	int minX, minY, maxX, maxY;
+	int blockX, blockY, blockW, blockH, baseX, baseY;
+	int link, door, belowLink, belowDoor;
+	int *open;
+	int x, y, localX, localY, flags;
+
+	// Closed walls everywhere, then open what the maze carves
+	for( y = 0; y < height; y++ )
+	{
+		for( x = 0; x < width; x++ )
+		{
+			maze_set_bit( eastWalls, rowWords, x, y );
+			maze_set_bit( southWalls, rowWords, x, y );
+		}
+	}
+
+	minX = originX < 0 ? 0 : originX;
+	minY = originY < 0 ? 0 : originY;
+	maxX = originX + width - 1 < mazeWidth - 1 ? originX + width - 1 : mazeWidth - 1;
+	maxY = originY + height - 1 < mazeHeight - 1 ? originY + height - 1 : mazeHeight - 1;
+	if( minX > maxX || minY > maxY )
+		return ({ eastWalls, southWalls });
+
+	for( blockY = minY / MAZE_BLOCK_SIZE; blockY <= maxY / MAZE_BLOCK_SIZE; blockY++ )
+	{
+		for( blockX = minX / MAZE_BLOCK_SIZE; blockX <= maxX / MAZE_BLOCK_SIZE; blockX++ )
+		{
+			baseX = blockX * MAZE_BLOCK_SIZE;
+			baseY = blockY * MAZE_BLOCK_SIZE;
+			blockW = maze_block_span( blockX, MAZE_BLOCK_SIZE, mazeWidth );
+			blockH = maze_block_span( blockY, MAZE_BLOCK_SIZE, mazeHeight );
+			open = maze_carve_block( blockX, blockY, blockW, blockH, seed );
+
+			// The east edge is opened by this block's own link; the south edge
+			//  by the link of the block below, if that one points north.
+			link = maze_block_link( blockX, blockY, blocksWide, seed );
+			door = Get3dNoise( blockX, blockY, MAZE_SALT_DOOR, seed );
+			belowLink = MAZE_LINK_NONE;
+			belowDoor = 0;
+			if( blockY + 1 < blocksHigh )
+			{
+				belowLink = maze_block_link( blockX, blockY + 1, blocksWide, seed );
+				belowDoor = Get3dNoise( blockX, blockY + 1, MAZE_SALT_DOOR, seed ) % blockW;
+			}
+
+			for( localY = 0; localY < blockH; localY++ )
+			{
+				y = baseY + localY - originY;
+				if( y < 0 || y >= height )
+					continue;
+				for( localX = 0; localX < blockW; localX++ )
+				{
+					x = baseX + localX - originX;
+					if( x < 0 || x >= width )
+						continue;
+
+					flags = open[ localY * blockW + localX ];
+					if( localX == blockW - 1 && link == MAZE_LINK_EAST
+						&& localY == door % blockH )
+						flags |= MAZE_OPEN_EAST;
+					if( localY == blockH - 1 && belowLink == MAZE_LINK_NORTH
+						&& localX == belowDoor )
+						flags |= MAZE_OPEN_SOUTH;
+
+					if( flags & MAZE_OPEN_EAST )
+						eastWalls[ y * rowWords + x / CA_BITS_PER_WORD ] &= ~( 1 << ( x % CA_BITS_PER_WORD ) );
+					if( flags & MAZE_OPEN_SOUTH )
+						southWalls[ y * rowWords + x / CA_BITS_PER_WORD ] &= ~( 1 << ( x % CA_BITS_PER_WORD ) );
+				}
+			}
+		}
+	}
+	return ({ eastWalls, southWalls });
+}
+
+//--------------------------------------------------------------------------
+int *MazeGenerateTiles( int originX, int originY, int width, int height, int mazeWidth, int mazeHeight, int seed )
+{
+	int tilesWide = 2 * width + 1;
+	int tilesHigh = 2 * height + 1;
+	int *tiles = allocate( CaRowWords( tilesWide ) * tilesHigh );
+	int *walls;
+	int x, y, cellX, cellY;
+
+	// One extra row and column up-left supplies the west and north edges
+	walls = MazeGenerateRegion( originX - 1, originY - 1, width + 1, height + 1, mazeWidth, mazeHeight, seed );
+
+	for( y = 0; y < tilesHigh; y++ )
+		for( x = 0; x < tilesWide; x++ )
+			CaSetCell( tiles, tilesWide, tilesHigh, x, y, 1 );
+
+	for( y = 0; y <= height; y++ )
+	{
+		for( x = 0; x <= width; x++ )
+		{
+			// (x, y) indexes the extended region; tile column 2x is its east edge
+			cellX = originX - 1 + x;
+			cellY = originY - 1 + y;
+			if( x > 0 && y > 0 && cellX >= 0 && cellY >= 0
+				&& cellX < mazeWidth && cellY < mazeHeight )
+				CaSetCell( tiles, tilesWide, tilesHigh, 2 * x - 1, 2 * y - 1, 0 );
+			if( y > 0 && !CaGetCell( walls[0], width + 1, height + 1, x, y ) )
+				CaSetCell( tiles, tilesWide, tilesHigh, 2 * x, 2 * y - 1, 0 );
+			if( x > 0 && !CaGetCell( walls[1], width + 1, height + 1, x, y ) )
+				CaSetCell( tiles, tilesWide, tilesHigh, 2 * x - 1, 2 * y, 0 );
+		}
+	}
+	return tiles;
+}
+
+//--------------------------------------------------------------------------
+// The room carved in a dungeon block, as ({ x, y, w, h }) in world tiles.
+//  A one-tile margin keeps neighboring rooms from merging.
+//
+private int *dungeon_block_room( int blockX, int blockY, int seed )
+{
+	int span = DUNGEON_BLOCK_SIZE - 2 - DUNGEON_MIN_ROOM + 1;
+	int roomW = DUNGEON_MIN_ROOM + Get3dNoise( blockX, blockY, MAZE_SALT_ROOM_W, seed ) % span;
+	int roomH = DUNGEON_MIN_ROOM + Get3dNoise( blockX, blockY, MAZE_SALT_ROOM_H, seed ) % span;
+	int roomX = 1 + Get3dNoise( blockX, blockY, MAZE_SALT_ROOM_X, seed ) % ( DUNGEON_BLOCK_SIZE - 1 - roomW );
+	int roomY = 1 + Get3dNoise( blockX, blockY, MAZE_SALT_ROOM_Y, seed ) % ( DUNGEON_BLOCK_SIZE - 1 - roomH );
+
+	return ({ blockX * DUNGEON_BLOCK_SIZE + roomX, blockY * DUNGEON_BLOCK_SIZE + roomY, roomW, roomH });
+}
+
+//--------------------------------------------------------------------------
+// Clear a world-space rectangle of tiles, clipped to the output bitmap.
+//
+private void dungeon_clear_rect( int *tiles, int originX, int originY, int width, int height, int rectX, int rectY, int rectW, int rectH )
+{
+	int x, y;
+
+	for( y = rectY; y < rectY + rectH; y++ )
+		for( x = rectX; x < rectX + rectW; x++ )
+			CaSetCell( tiles, width, height, x - originX, y - originY, 0 );
+}
+
+//--------------------------------------------------------------------------
+int *DungeonGenerateTiles( int originX, int originY, int width, int height, int roomsWide, int roomsHigh, int seed )
+{
+	int *tiles = allocate( CaRowWords( width ) * height );
+	int minBlockX, minBlockY, maxBlockX, maxBlockY;
+	int blockX, blockY, link, fromX, fromY, toX, toY, bendX, bendY;
+	int *room, *other;
+	int x, y;
+
+	for( y = 0; y < height; y++ )
+		for( x = 0; x < width; x++ )
+			CaSetCell( tiles, width, height, x, y, 1 );
+
+	// A corridor stays inside the two blocks it joins, so one block of
+	//  margin around the region catches every corridor that can cross it.
+	minBlockX = ( originX < 0 ? 0 : originX / DUNGEON_BLOCK_SIZE ) - 1;
+	minBlockY = ( originY < 0 ? 0 : originY / DUNGEON_BLOCK_SIZE ) - 1;
+	maxBlockX = ( originX + width - 1 ) / DUNGEON_BLOCK_SIZE + 1;
+	maxBlockY = ( originY + height - 1 ) / DUNGEON_BLOCK_SIZE + 1;
+	if( minBlockX < 0 ) minBlockX = 0;
+	if( minBlockY < 0 ) minBlockY = 0;
+	if( maxBlockX > roomsWide - 1 ) maxBlockX = roomsWide - 1;
+	if( maxBlockY > roomsHigh - 1 ) maxBlockY = roomsHigh - 1;
+
+	for( blockY = minBlockY; blockY <= maxBlockY; blockY++ )
+	{
+		for( blockX = minBlockX; blockX <= maxBlockX; blockX++ )
+		{
+			room = dungeon_block_room( blockX, blockY, seed );
+			dungeon_clear_rect( tiles, originX, originY, width, height,
+				room[0], room[1], room[2], room[3] );
+
+			link = maze_block_link( blockX, blockY, roomsWide, seed );
+			if( link == MAZE_LINK_NONE )
+				continue;
+			if( link == MAZE_LINK_EAST )
+				other = dungeon_block_room( blockX + 1, blockY, seed );
+			else
+				other = dungeon_block_room( blockX, blockY - 1, seed );
+
+			// L-shaped corridor between room centers, bending either way
+			fromX = room[0] + room[2] / 2;
+			fromY = room[1] + room[3] / 2;
+			toX = other[0] + other[2] / 2;
+			toY = other[1] + other[3] / 2;
+			if( Get3dNoise( blockX, blockY, MAZE_SALT_BEND, seed ) & 1 )
+			{
+				bendX = toX;
+				bendY = fromY;
+			}
+			else
+			{
+				bendX = fromX;
+				bendY = toY;
+			}
+			dungeon_clear_rect( tiles, originX, originY, width, height,
+				fromX < bendX ? fromX : bendX, fromY < bendY ? fromY : bendY,
+				( fromX < bendX ? bendX - fromX : fromX - bendX ) + 1,
+				( fromY < bendY ? bendY - fromY : fromY - bendY ) + 1 );
+			dungeon_clear_rect( tiles, originX, originY, width, height,
+				toX < bendX ? toX : bendX, toY < bendY ? toY : bendY,
+				( toX < bendX ? bendX - toX : toX - bendX ) + 1,
+				( toY < bendY ? bendY - toY : toY - bendY ) + 1 );
+		}
+	}
+	return tiles;
+}
+
+#endif
@@ -0,0 +1,241 @@
+// montecarlo.h
+// Deterministic Monte Carlo harness for balance testing
+// Built on noise.h (SquirrelNoise5) and gaussian.h
+
+#ifndef _MONTECARLO_H
+#define _MONTECARLO_H
+
+#include "noise.h"
+#include "gaussian.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Monte Carlo simulation
+//
+// Kernels are functions registered by name.  Each trial calls
+//  kernel( stream, params ) and the number it returns is tallied into a
+//  histogram.  The stream is the trial's own source of random numbers:
+//  value n of trial t is Get2dNoise( t, n, seed ), so a trial is fully
+//  determined by its index and the seed and never by which trials ran
+//  before it.
+//
+// Results only hold integers (counts, a fixed-point sum, min and max), so
+//  merging partial results is exact and associative.  A run split into
+//  any number of slices, whether run in one go or spread over call_outs
+//  (SimRunAsync), gives bit-identical results.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define SIM_FIXED_SCALE         1000000 // Sum is kept in millionths
+#define SIM_DEFAULT_CHUNK       2000    // Trials per call_out in SimRunAsync
+
+// Stream layout
+#define SIM_STREAM_TRIAL        0
+#define SIM_STREAM_SEED         1
+#define SIM_STREAM_COUNTER      2
+
+//--------------------------------------------------------------------------
+// Per-trial random streams, for use inside kernels.
+//
+mixed *SimStream( int trial, int seed );
+int SimStreamNext( mixed *stream );
+float SimStreamFloat( mixed *stream );
+int SimStreamRange( mixed *stream, int low, int high );
+float SimStreamGaussian( mixed *stream );
+
+//--------------------------------------------------------------------------
+// Kernel registry.
+//
+void SimRegisterKernel( string name, function kernel );
+void SimUnregisterKernel( string name );
+
+//--------------------------------------------------------------------------
+// Run count trials from firstTrial.  Outcomes are binned into buckets
+//  equal bins over [low, high); anything outside goes to underflow or
+//  overflow.  Returns a result mapping with keys "trials", "histogram",
+//  "underflow", "overflow", "sum", "min", "max" and "low", "high".
+//
+mapping SimRunRange( string name, int firstTrial, int count, int seed, mixed params, float low, float high, int buckets );
+mapping SimMergeResults( mapping a, mapping b );
+float SimResultMean( mapping result );
+
+//--------------------------------------------------------------------------
+// Run trials 0 .. trials - 1 chunk by chunk over call_outs, then call
+//  callback( result ).  chunk 0 means SIM_DEFAULT_CHUNK.
+//
+void SimRunAsync( string name, int trials, int seed, mixed params, float low, float high, int buckets, int chunk, function callback );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// name -> kernel
+nosave private mapping sim_kernels = ([]);
+
+//--------------------------------------------------------------------------
+mixed *SimStream( int trial, int seed )
+{
+	return ({ trial, seed, 0 });
+}
+
+//--------------------------------------------------------------------------
+int SimStreamNext( mixed *stream )
+{
+	return Get2dNoise( stream[SIM_STREAM_TRIAL], stream[SIM_STREAM_COUNTER]++,
+		stream[SIM_STREAM_SEED] );
+}
+
+//--------------------------------------------------------------------------
+float SimStreamFloat( mixed *stream )
+{
+	return ( 1.0 * SimStreamNext( stream ) ) / ( 1.0 + INT_32_UNSIGNED_MAX );
+}
+
+//--------------------------------------------------------------------------
+// Uniform integer in [low, high].
+//
+int SimStreamRange( mixed *stream, int low, int high )
+{
+	return low + ( ( SimStreamNext( stream ) * ( high - low + 1 ) ) >> 32 );
+}
+
+//--------------------------------------------------------------------------
+float SimStreamGaussian( mixed *stream )
+{
+	return NoiseBitsToGaussian( SimStreamNext( stream ) );
+}
+
+//--------------------------------------------------------------------------
+void SimRegisterKernel( string name, function kernel )
+{
+	sim_kernels[name] = kernel;
+}
+
+//--------------------------------------------------------------------------
+void SimUnregisterKernel( string name )
+{
+	map_delete( sim_kernels, name );
+}
+
+//--------------------------------------------------------------------------
+private mapping sim_empty_result( float low, float high, int buckets )
+{
+	return ([
+		"trials" : 0,
+		"histogram" : allocate( buckets ),
+		"underflow" : 0,
+		"overflow" : 0,
+		"sum" : 0,
+		"min" : 0,
+		"max" : 0,
+		"low" : low,
+		"high" : high,
+	]);
+}
+
+//--------------------------------------------------------------------------
+mapping SimRunRange( string name, int firstTrial, int count, int seed, mixed params, float low, float high, int buckets )
+{
+	function kernel = sim_kernels[name];
+	mapping result = sim_empty_result( low, high, buckets );
+	int *histogram = result["histogram"];
+	float width = ( high - low ) / buckets;
+	int trial, bucket, fixed;
+	int sum = 0;
+	int minimum = 0;
+	int maximum = 0;
+	mixed outcome;
+
+	if( !kernel )
+		error( "SimRunRange: no kernel registered as " + name + "\n" );
+
+	for( trial = firstTrial; trial < firstTrial + count; trial++ )
+	{
+		outcome = evaluate( kernel, SimStream( trial, seed ), params );
+		fixed = to_int( floor( outcome * 1.0 * SIM_FIXED_SCALE + 0.5 ) );
+		sum += fixed;
+		if( trial == firstTrial || fixed < minimum )
+			minimum = fixed;
+		if( trial == firstTrial || fixed > maximum )
+			maximum = fixed;
+
+		if( outcome < low )
+			result["underflow"]++;
+		else if( outcome >= high )
+			result["overflow"]++;
+		else
+		{
+			bucket = to_int( ( outcome - low ) / width );
+			histogram[ bucket < buckets ? bucket : buckets - 1 ]++;
+		}
+	}
+
+	result["trials"] = count;
+	result["sum"] = sum;
+	result["min"] = minimum;
+	result["max"] = maximum;
+	return result;
+}
+
+//--------------------------------------------------------------------------
+mapping SimMergeResults( mapping a, mapping b )
+{
+	mapping result;
+	int i;
+
+	if( !a["trials"] )
+		return b;
+	if( !b["trials"] )
+		return a;
+
+	result = sim_empty_result( a["low"], a["high"], sizeof( a["histogram"] ) );
+	for( i = 0; i < sizeof( a["histogram"] ); i++ )
+		result["histogram"][i] = a["histogram"][i] + b["histogram"][i];
+	result["trials"] = a["trials"] + b["trials"];
+	result["underflow"] = a["underflow"] + b["underflow"];
+	result["overflow"] = a["overflow"] + b["overflow"];
+	result["sum"] = a["sum"] + b["sum"];
+	result["min"] = a["min"] < b["min"] ? a["min"] : b["min"];
+	result["max"] = a["max"] > b["max"] ? a["max"] : b["max"];
+	return result;
+}
+
+//--------------------------------------------------------------------------
+float SimResultMean( mapping result )
+{
+	if( !result["trials"] )
+		return 0.0;
+	return ( 1.0 * result["sum"] ) / SIM_FIXED_SCALE / result["trials"];
+}
+
+//--------------------------------------------------------------------------
+private void sim_async_step( string name, int next, int trials, int seed, mixed params, float low, float high, int buckets, int chunk, function callback, mapping result )
+{
+	int count = trials - next < chunk ? trials - next : chunk;
+
+	result = SimMergeResults( result,
+		SimRunRange( name, next, count, seed, params, low, high, buckets ) );
+	next += count;
+
+	if( next < trials )
+		call_out( (: sim_async_step :), 0, name, next, trials, seed, params,
+			low, high, buckets, chunk, callback, result );
+	else
+		evaluate( callback, result );
+}
+
+//--------------------------------------------------------------------------
+void SimRunAsync( string name, int trials, int seed, mixed params, float low, float high, int buckets, int chunk, function callback )
+{
+	if( chunk <= 0 )
+		chunk = SIM_DEFAULT_CHUNK;
+	if( trials <= 0 )
+	{
+		evaluate( callback, sim_empty_result( low, high, buckets ) );
+		return;
+	}
+	call_out( (: sim_async_step :), 0, name, 0, trials, seed, params,
+		low, high, buckets, chunk, callback, sim_empty_result( low, high, buckets ) );
+}
+
+#endif
@@ -0,0 +1,195 @@
+// namegen.h
+// Markov chain name generator driven by SquirrelNoise5
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _NAMEGEN_H
+#define _NAMEGEN_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Name generation
+//
+// A model is compiled once from a corpus of example names (one per line,
+//  or one file with one name per line) into an order-N character Markov
+//  chain: for every N-letter context it stores the letters that followed
+//  it, as a cumulative weight table.  Contexts are padded with '^' at the
+//  start and a name ends when '$' is drawn.
+//
+// Names are a pure function of (id, seed): letter n of name id is chosen
+//  by Get2dNoise( id, n, seed ), so the same NPC always gets the same name.
+//  Names are rejected and redrawn (with the attempt number folded into the
+//  seed) when they fall outside the length limits or copy a corpus name
+//  verbatim, so the result is still deterministic.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define NAMEGEN_DEFAULT_ORDER   2
+#define NAMEGEN_MIN_LENGTH      3
+#define NAMEGEN_MAX_LENGTH      12
+#define NAMEGEN_MAX_ATTEMPTS    16
+
+// Model layout
+#define NAMEGEN_ORDER           0       // int
+#define NAMEGEN_CHAINS          1       // ([ context : ({ letters, cumulative weights }) ])
+#define NAMEGEN_CORPUS          2       // ([ name : 1 ]), to avoid copying real names
+
+//--------------------------------------------------------------------------
+// Compile a model from a list of names, or from a file with one name per
+//  line.  Names are lower-cased.
+//
+mixed *NameModelCompile( string *names, int order );
+mixed *NameModelCompileFile( string path, int order );
+
+//--------------------------------------------------------------------------
+// Generate the name for an ID (capitalized), or names for count IDs from
+//  firstId in one call.
+//
+string NameGenerate( mixed *model, int id, int seed );
+string *NameGenerateBatch( mixed *model, int firstId, int count, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private string namegen_padding( int order )
+{
+	string padding = "";
+
+	while( order-- > 0 )
+		padding += "^";
+	return padding;
+}
+
+//--------------------------------------------------------------------------
+mixed *NameModelCompile( string *names, int order )
+{
+	mapping counts = ([]);
+	mapping chains = ([]);
+	mapping corpus = ([]);
+	string name, padded, context, next;
+	string *letters;
+	int *weights;
+	int i, total;
+
+	if( order < 1 )
+		order = NAMEGEN_DEFAULT_ORDER;
+
+	// Count transitions: context -> ([ next letter : count ])
+	foreach( name in names )
+	{
+		name = lower_case( name );
+		if( name == "" )
+			continue;
+		corpus[name] = 1;
+		padded = namegen_padding( order ) + name + "$";
+		for( i = order; i < strlen( padded ); i++ )
+		{
+			context = padded[ i - order .. i - 1 ];
+			next = padded[i .. i];
+			if( !counts[context] )
+				counts[context] = ([]);
+			counts[context][next]++;
+		}
+	}
+
+	// Freeze into sorted letters and cumulative weights so generation does
+	//  not depend on mapping order
+	foreach( context in keys( counts ) )
+	{
+		letters = sort_array( keys( counts[context] ), 1 );
+		weights = allocate( sizeof( letters ) );
+		total = 0;
+		for( i = 0; i < sizeof( letters ); i++ )
+		{
+			total += counts[context][ letters[i] ];
+			weights[i] = total;
+		}
+		chains[context] = ({ letters, weights });
+	}
+
+	return ({ order, chains, corpus });
+}
+
+//--------------------------------------------------------------------------
+mixed *NameModelCompileFile( string path, int order )
+{
+	string text = read_file( path );
+
+	if( !text )
+		return 0;
+	return NameModelCompile( explode( replace_string( text, "\r", "" ), "\n" ), order );
+}
+
+//--------------------------------------------------------------------------
+// One attempt at a name; returns 0 if the chain dead-ends or runs long.
+//
+private string namegen_attempt( mixed *model, int id, int seed )
+{
+	int order = model[NAMEGEN_ORDER];
+	mapping chains = model[NAMEGEN_CHAINS];
+	string name = namegen_padding( order );
+	mixed *chain;
+	int *weights;
+	int pick, low, high, middle, step;
+
+	for( step = 0; step <= NAMEGEN_MAX_LENGTH; step++ )
+	{
+		chain = chains[ name[<order .. ] ];
+		if( !chain )
+			return 0;
+		weights = chain[1];
+
+		// Weighted pick: first cumulative weight above the draw
+		pick = ( Get2dNoise( id, step, seed ) * weights[<1] ) >> 32;
+		low = 0;
+		high = sizeof( weights ) - 1;
+		while( low < high )
+		{
+			middle = ( low + high ) / 2;
+			if( weights[middle] > pick )
+				high = middle;
+			else
+				low = middle + 1;
+		}
+
+		if( chain[0][low] == "$" )
+			return name[order .. ];
+		name += chain[0][low];
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------
+string NameGenerate( mixed *model, int id, int seed )
+{
+	string name;
+	int attempt;
+
+	for( attempt = 0; attempt < NAMEGEN_MAX_ATTEMPTS; attempt++ )
+	{
+		name = namegen_attempt( model, id, attempt ? Get2dNoise( attempt, seed, seed ) : seed );
+		if( !name || strlen( name ) < NAMEGEN_MIN_LENGTH || strlen( name ) > NAMEGEN_MAX_LENGTH )
+			continue;
+		if( model[NAMEGEN_CORPUS][name] && attempt < NAMEGEN_MAX_ATTEMPTS - 1 )
+			continue;
+		return capitalize( name );
+	}
+	// Every attempt failed the length limits; settle for the last one
+	return name ? capitalize( name ) : "";
+}
+
+//--------------------------------------------------------------------------
+string *NameGenerateBatch( mixed *model, int firstId, int count, int seed )
+{
+	string *names = allocate( count );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		names[i] = NameGenerate( model, firstId + i, seed );
+	return names;
+}
+
+#endif
@@ -47,6 +47,27 @@
 #define INT_32_UNSIGNED_MAX     0xFFFFFFFF
 #define INT_32_SIGNED_MAX       0x7FFFFFFF
 
+// Bump NOISE_ALGORITHM_VERSION whenever any output of the functions below
+//  changes (hash constants, primes, mapping to floats).  The fingerprint
+//  catches changes that forgot the bump.
+#define NOISE_ALGORITHM_NAME    "SquirrelNoise5"
+#define NOISE_ALGORITHM_VERSION 1
+
+//--------------------------------------------------------------------------
+// Coordinate mixing for the N-dimensional functions: each axis after the
+//  first is scaled by its own prime and the results summed into a single
+//  index.  These are macros so every caller (Get*dNoise, the backends, the
+//  batch rows) expands to the same inline arithmetic with constant primes,
+//  and adding a dimension is one more line here rather than another copy.
+//
+#define NOISE_PRIME_Y           198491317 // Large prime number with non-boring bits
+#define NOISE_PRIME_Z           6542989   // Large prime number with distinct, non-boring bits
+#define NOISE_PRIME_T           357239    // Large prime number with distinct, non-boring bits
+
+#define NOISE_MIX_2D(x, y)          ( (x) + fake_uint32_overflow( NOISE_PRIME_Y * (y) ) )
+#define NOISE_MIX_3D(x, y, z)       ( NOISE_MIX_2D( x, y ) + fake_uint32_overflow( NOISE_PRIME_Z * (z) ) )
+#define NOISE_MIX_4D(x, y, z, t)    ( NOISE_MIX_3D( x, y, z ) + fake_uint32_overflow( NOISE_PRIME_T * (t) ) )
+
 //--------------------------------------------------------------------------
 // Raw pseudorandom noise functions (random-access / deterministic).  Basis
 //  of all other noise.
@@ -72,6 +93,13 @@ float Get2dNoiseNegOneToOne( int posX, int posY, int seed );
 float Get3dNoiseNegOneToOne( int posX, int posY, int posZ, int seed );
 float Get4dNoiseNegOneToOne( int posX, int posY, int posZ, int posT, int seed );
 
+//--------------------------------------------------------------------------
+// Algorithm identification, for cache keys, saved tiles and seed manifests.
+//  The fingerprint hashes sample outputs of every Get*dNoise function; the
+//  ID combines name, version and fingerprint, e.g. "SquirrelNoise5.1.1a2b3c4d".
+//
+int NoiseAlgorithmFingerprint();
+string NoiseAlgorithmId();
 
 ////////////////////////////////////////////////////////////////////////////
 // Function definitions below
@@ -153,37 +181,19 @@ int Get1dNoise( int positionX, int seed )
 //--------------------------------------------------------------------------
 int Get2dNoise( int posX, int posY, int seed )
 {
-	int PRIME_NUMBER = 198491317; // Large prime number with non-boring bits
-	return SquirrelNoise5( posX
-    + fake_uint32_overflow(PRIME_NUMBER * posY)
-    , seed
-  );
+	return SquirrelNoise5( NOISE_MIX_2D( posX, posY ), seed );
 }
 
 //--------------------------------------------------------------------------
 int Get3dNoise( int posX, int posY, int posZ, int seed )
 {
-	int PRIME1 = 198491317; // Large prime number with non-boring bits
-	int PRIME2 = 6542989;   // Large prime number with distinct, non-boring bits
-	return SquirrelNoise5( posX
-    + fake_uint32_overflow(PRIME1 * posY)
-    + fake_uint32_overflow(PRIME2 * posZ)
-    , seed
-  );
+	return SquirrelNoise5( NOISE_MIX_3D( posX, posY, posZ ), seed );
 }
 
 //--------------------------------------------------------------------------
 int Get4dNoise( int posX, int posY, int posZ, int posT, int seed )
 {
-	int PRIME1 = 198491317; // Large prime number with non-boring bits
-	int PRIME2 = 6542989;   // Large prime number with distinct, non-boring bits
-	int PRIME3 = 357239;    // Large prime number with distinct, non-boring bits
-	return SquirrelNoise5( posX
-    + fake_uint32_overflow(PRIME1 * posY)
-    + fake_uint32_overflow(PRIME2 * posZ)
-    + fake_uint32_overflow(PRIME3 * posT)
-    , seed
-  );
+	return SquirrelNoise5( NOISE_MIX_4D( posX, posY, posZ, posT ), seed );
 }
 
 //--------------------------------------------------------------------------
@@ -243,4 +253,21 @@ float Get4dNoiseNegOneToOne( int posX, int posY, int posZ, int posT, int seed )
 	return ( 1.0 * (result - INT_32_SIGNED_MAX) ) / INT_32_SIGNED_MAX;
 }
 
+//--------------------------------------------------------------------------
+int NoiseAlgorithmFingerprint()
+{
+	int fingerprint = Get1dNoise( 0x2545F491, 0x6C078965 );
+	fingerprint = Get2dNoise( fingerprint, -17, 1 ) ^ Get1dNoise( -1, fingerprint );
+	fingerprint = Get3dNoise( 12345, fingerprint, -678, 90 ) ^ fingerprint;
+	fingerprint = Get4dNoise( -3, 5, fingerprint, 7, 11 ) ^ fingerprint;
+	return fingerprint & INT_32_UNSIGNED_MAX;
+}
+
+//--------------------------------------------------------------------------
+string NoiseAlgorithmId()
+{
+	return sprintf( "%s.%d.%08x", NOISE_ALGORITHM_NAME, NOISE_ALGORITHM_VERSION,
+		NoiseAlgorithmFingerprint() );
+}
+
 #endif
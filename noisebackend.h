@@ -0,0 +1,278 @@
+// noisebackend.h
+// Selectable hash backends with the Get*dNoise interface
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _NOISEBACKEND_H
+#define _NOISEBACKEND_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Hash backends
+//
+// The raw N-dimensional noise functions here take a backend as their first
+//  argument and otherwise behave like Get1dNoise..Get4dNoise: coordinates
+//  are folded with the same NOISE_MIX_*D macros, and every backend returns
+//  32 bits.
+//
+//  NOISE_BACKEND_SQUIRREL5  SquirrelNoise5 itself; identical to Get*dNoise.
+//  NOISE_BACKEND_LOWBIAS    Two multiplies (Chris Wellons' "lowbias32"
+//                           mixer) after folding the seed in with a
+//                           rotate and xor.  Cheaper; fine for bulk jobs
+//                           that only need the values to look random.
+//  NOISE_BACKEND_STRONG     SquirrelNoise5 followed by the MurmurHash3
+//                           finalizer, for the rare job that needs better
+//                           avalanche than SquirrelNoise5 alone.
+//
+// A generator picks its backend once and passes it along; valuenoise.h has
+//  GetBackend* value noise and fBm, and noisegraph.h sources take one via
+//  NoiseGraphSetBackend.  Note that backends give different values for
+//  the same input, so a backend change is a world change just like an
+//  algorithm version change.
+//
+// NoiseBenchmarkBackend and NoiseAnalyzeBackend measure speed and quality
+//  (per-bit bias and worst-case avalanche) so the choice can be made from
+//  data; NoiseCompareBackends runs both over every backend.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define NOISE_BACKEND_SQUIRREL5 0
+#define NOISE_BACKEND_LOWBIAS   1
+#define NOISE_BACKEND_STRONG    2
+#define NOISE_BACKEND_COUNT     3
+
+//--------------------------------------------------------------------------
+// Raw noise through a chosen backend.
+//
+int NoiseBackendHash( int backend, int index, int seed );
+int GetBackend1dNoise( int backend, int index, int seed );
+int GetBackend2dNoise( int backend, int posX, int posY, int seed );
+int GetBackend3dNoise( int backend, int posX, int posY, int posZ, int seed );
+int GetBackend4dNoise( int backend, int posX, int posY, int posZ, int posT, int seed );
+string NoiseBackendName( int backend );
+
+//--------------------------------------------------------------------------
+// Batch rows: count consecutive X positions from originX on one row,
+//  identical to calling GetBackend*dNoise per cell.
+//
+int *GetBackend1dNoiseRow( int backend, int originX, int count, int seed );
+int *GetBackend2dNoiseRow( int backend, int originX, int posY, int count, int seed );
+int *GetBackend3dNoiseRow( int backend, int originX, int posY, int posZ, int count, int seed );
+int *GetBackend4dNoiseRow( int backend, int originX, int posY, int posZ, int posT, int count, int seed );
+
+//--------------------------------------------------------------------------
+// Measurement.  The benchmark returns hashes per CPU second; the analyzer
+//  returns ([ "worst_bias" : float, "worst_avalanche" : float ]), both as
+//  distance from the ideal 0.5 (0.0 is perfect).
+//
+float NoiseBenchmarkBackend( int backend, int samples );
+mapping NoiseAnalyzeBackend( int backend, int samples, int seed );
+mapping NoiseCompareBackends( int samples, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private int noise_lowbias32( int index, int seed )
+{
+	int bits = ( index ^ ( ( seed << 16 ) | ( ( seed & INT_32_UNSIGNED_MAX ) >> 16 ) ) ) & INT_32_UNSIGNED_MAX;
+
+	bits = bits ^ ( bits >> 16 );
+	bits = ( bits * 0x7feb352d ) & INT_32_UNSIGNED_MAX;
+	bits = bits ^ ( bits >> 15 );
+	bits = ( bits * 0x846ca68b ) & INT_32_UNSIGNED_MAX;
+	bits = bits ^ ( bits >> 16 );
+	return bits;
+}
+
+//--------------------------------------------------------------------------
+private int noise_murmur_finalize( int bits )
+{
+	bits = bits ^ ( bits >> 16 );
+	bits = ( bits * 0x85ebca6b ) & INT_32_UNSIGNED_MAX;
+	bits = bits ^ ( bits >> 13 );
+	bits = ( bits * 0xc2b2ae35 ) & INT_32_UNSIGNED_MAX;
+	bits = bits ^ ( bits >> 16 );
+	return bits;
+}
+
+//--------------------------------------------------------------------------
+int NoiseBackendHash( int backend, int index, int seed )
+{
+	switch( backend )
+	{
+		case NOISE_BACKEND_LOWBIAS:
+			return noise_lowbias32( index, seed );
+		case NOISE_BACKEND_STRONG:
+			return noise_murmur_finalize( SquirrelNoise5( index, seed ) );
+		default:
+			return SquirrelNoise5( index, seed );
+	}
+}
+
+//--------------------------------------------------------------------------
+string NoiseBackendName( int backend )
+{
+	switch( backend )
+	{
+		case NOISE_BACKEND_LOWBIAS:
+			return "lowbias32";
+		case NOISE_BACKEND_STRONG:
+			return "squirrel5+murmur";
+		default:
+			return "squirrel5";
+	}
+}
+
+//--------------------------------------------------------------------------
+int GetBackend1dNoise( int backend, int index, int seed )
+{
+	return NoiseBackendHash( backend, index, seed );
+}
+
+//--------------------------------------------------------------------------
+int GetBackend2dNoise( int backend, int posX, int posY, int seed )
+{
+	return NoiseBackendHash( backend, NOISE_MIX_2D( posX, posY ), seed );
+}
+
+//--------------------------------------------------------------------------
+int GetBackend3dNoise( int backend, int posX, int posY, int posZ, int seed )
+{
+	return NoiseBackendHash( backend, NOISE_MIX_3D( posX, posY, posZ ), seed );
+}
+
+//--------------------------------------------------------------------------
+int GetBackend4dNoise( int backend, int posX, int posY, int posZ, int posT, int seed )
+{
+	return NoiseBackendHash( backend, NOISE_MIX_4D( posX, posY, posZ, posT ), seed );
+}
+
+//--------------------------------------------------------------------------
+// The mixed index is linear in X, so the Y/Z/T terms are folded once per
+//  row and each cell only adds its X offset.
+//
+private int *noise_backend_row( int backend, int base, int count, int seed )
+{
+	int *row = allocate( count );
+	int i;
+
+	switch( backend )
+	{
+		case NOISE_BACKEND_LOWBIAS:
+			for( i = 0; i < count; i++ )
+				row[i] = noise_lowbias32( base + i, seed );
+			break;
+		case NOISE_BACKEND_STRONG:
+			for( i = 0; i < count; i++ )
+				row[i] = noise_murmur_finalize( SquirrelNoise5( base + i, seed ) );
+			break;
+		default:
+			for( i = 0; i < count; i++ )
+				row[i] = SquirrelNoise5( base + i, seed );
+			break;
+	}
+	return row;
+}
+
+//--------------------------------------------------------------------------
+int *GetBackend1dNoiseRow( int backend, int originX, int count, int seed )
+{
+	return noise_backend_row( backend, originX, count, seed );
+}
+
+//--------------------------------------------------------------------------
+int *GetBackend2dNoiseRow( int backend, int originX, int posY, int count, int seed )
+{
+	return noise_backend_row( backend, NOISE_MIX_2D( originX, posY ), count, seed );
+}
+
+//--------------------------------------------------------------------------
+int *GetBackend3dNoiseRow( int backend, int originX, int posY, int posZ, int count, int seed )
+{
+	return noise_backend_row( backend, NOISE_MIX_3D( originX, posY, posZ ), count, seed );
+}
+
+//--------------------------------------------------------------------------
+int *GetBackend4dNoiseRow( int backend, int originX, int posY, int posZ, int posT, int count, int seed )
+{
+	return noise_backend_row( backend, NOISE_MIX_4D( originX, posY, posZ, posT ), count, seed );
+}
+
+//--------------------------------------------------------------------------
+float NoiseBenchmarkBackend( int backend, int samples )
+{
+	int start, elapsed, i;
+
+	start = rusage()["utime"];
+	for( i = 0; i < samples; i++ )
+		NoiseBackendHash( backend, i, 0 );
+	elapsed = rusage()["utime"] - start;
+
+	// utime is in milliseconds; a zero reading means "too fast to measure"
+	return elapsed > 0 ? samples * 1000.0 / elapsed : 0.0;
+}
+
+//--------------------------------------------------------------------------
+mapping NoiseAnalyzeBackend( int backend, int samples, int seed )
+{
+	int *ones = allocate( 32 );
+	int *flips = allocate( 32 * 32 );
+	int i, inBit, outBit, base, changed;
+	float bias, worstBias, worstAvalanche;
+
+	for( i = 0; i < samples; i++ )
+	{
+		base = NoiseBackendHash( backend, i, seed );
+		for( outBit = 0; outBit < 32; outBit++ )
+			ones[outBit] += ( base >> outBit ) & 1;
+
+		// Avalanche: how often each input bit flips each output bit
+		for( inBit = 0; inBit < 32; inBit++ )
+		{
+			changed = base ^ NoiseBackendHash( backend, i ^ ( 1 << inBit ), seed );
+			for( outBit = 0; outBit < 32; outBit++ )
+				flips[ inBit * 32 + outBit ] += ( changed >> outBit ) & 1;
+		}
+	}
+
+	worstBias = 0.0;
+	for( outBit = 0; outBit < 32; outBit++ )
+	{
+		bias = ( 1.0 * ones[outBit] ) / samples - 0.5;
+		bias = bias < 0.0 ? -bias : bias;
+		if( bias > worstBias )
+			worstBias = bias;
+	}
+
+	worstAvalanche = 0.0;
+	for( i = 0; i < 32 * 32; i++ )
+	{
+		bias = ( 1.0 * flips[i] ) / samples - 0.5;
+		bias = bias < 0.0 ? -bias : bias;
+		if( bias > worstAvalanche )
+			worstAvalanche = bias;
+	}
+
+	return ([ "worst_bias" : worstBias, "worst_avalanche" : worstAvalanche ]);
+}
+
+//--------------------------------------------------------------------------
+mapping NoiseCompareBackends( int samples, int seed )
+{
+	mapping result = ([]);
+	mapping quality;
+	int backend;
+
+	for( backend = 0; backend < NOISE_BACKEND_COUNT; backend++ )
+	{
+		quality = NoiseAnalyzeBackend( backend, samples, seed );
+		quality["hashes_per_second"] = NoiseBenchmarkBackend( backend, samples );
+		result[ NoiseBackendName( backend ) ] = quality;
+	}
+	return result;
+}
+
+#endif
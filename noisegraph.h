@@ -0,0 +1,859 @@
+// noisegraph.h
+// Noise module graphs evaluated in fused, cache-blocked tiles
+// Built on noise.h (SquirrelNoise5), valuenoise.h (value noise, fBm),
+//  noisebackend.h, tilecache.h and sparsegrid.h
+
+#ifndef _NOISEGRAPH_H
+#define _NOISEGRAPH_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "noisebackend.h"
+#include "tilecache.h"
+#include "sparsegrid.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Noise graphs
+//
+// A generator such as "fBm, scaled, plus a ridge layer, clamped, then
+//  ocean where a mask is low" is built once as a graph of modules: sources
+//  (constants, white noise, value noise, fBm) and combinators (scale/bias,
+//  add, multiply, clamp, select).  Every builder call returns the new
+//  node's ID; inputs must be nodes that already exist, so IDs are always in
+//  dependency order.
+//
+// Compiling walks back from the output node, drops modules the output does
+//  not use and assigns every remaining module a temporary slot, reusing a
+//  slot as soon as the value in it has been read for the last time.  The
+//  compiled program is kept in the graph and rebuilt only after the graph
+//  changes.
+//
+// Evaluation runs the whole program over one NOISE_GRAPH_BLOCK square
+//  block at a time, so intermediate values only ever live in a handful of
+//  block-sized slot arrays that are reused for every block, instead of one
+//  full-size grid per operation.  The result is a row-major float grid, as
+//  from Get2dFbmGrid, and does not depend on the block size.
+//
+// Cell (x, y) is sampled at (x / scale, y / scale) by value noise and fBm;
+//  white noise is Get2dNoiseZeroToOne( x, y, seed ).  Each noise source
+//  also carries a noisebackend.h backend as its last parameter, so a
+//  generator can pick one per source: it starts as NOISE_BACKEND_SQUIRREL5
+//  and NoiseGraphSetBackend changes it, after which the source hashes with
+//  GetBackend2dNoise and the GetBackend* value noise and fBm instead.
+//
+// Serialization: NoiseGraphSerialize writes the modules the output uses
+//  as compact text:
+//
+//      noisegraph2;op,inputCount,input...,param...;...
+//
+//  with floats in TileCacheEncodeFloat form, so they read back exactly.
+//  NoiseGraphParse reads it back.  Modules are written depth first from
+//  the output, each after its inputs in input order, and renumbered in
+//  that order, so the output is the last node and the text does not depend
+//  on the order the builder calls were made in: graphs with the same
+//  modules, parameters and wiring serialize identically.  NoiseGraphHash
+//  (a 64-bit SquirrelNoise5 chain over the text, as 16 hex digits) is then
+//  a content hash.  NoiseGraphTile keys its tile cache entries by that
+//  hash, so identical graphs in different zones share cached tiles, and
+//  any parameter change moves to fresh keys instead of serving stale
+//  tiles.  Text in the older noisegraph1 format, from before sources had a
+//  backend, still parses, with the default backend.
+//
+// Incremental evaluation: every node also has its own hash, built from its
+//  kind, parameters and its inputs' hashes, so a node's hash only changes
+//  when something upstream of it changed.  NoiseGraphEvaluateIncremental
+//  evaluates node by node over the whole region and keeps every node's
+//  result in the tile cache under that hash.  After NoiseGraphSetParam
+//  (which forgets the hashes of the edited node and its dependents), only
+//  those nodes are recomputed; the base fBm and anything else upstream
+//  comes straight from the cache.  This trades memory for turnaround and is
+//  meant for builder tools iterating on parameters; raise the tile cache
+//  capacity to hold a few entries per node.  Game-time generation should
+//  keep using NoiseGraphEvaluate or NoiseGraphTile.
+//
+// Masked evaluation: NoiseGraphEvaluateMasked takes a sparsegrid.h mask and
+//  returns only the selected cells, compacted the same way as the
+//  sparsegrid.h functions.  Blocks with no selected cells are skipped
+//  outright.  Blocks with at least SPARSE_DENSE_FILL of their cells
+//  selected run the whole program densely, so fBm sources keep sharing
+//  lattice values; sparser blocks run it over just their selected cells,
+//  so the whole graph (not only its sources) costs in proportion to the
+//  selected area.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define NOISE_GRAPH_BLOCK       16      // Cells per side of an evaluation block; must divide 32
+
+// Module kinds.  Sources (no inputs) come first.
+#define NOISE_OP_CONST          0       // params: ({ value })
+#define NOISE_OP_WHITE          1       // params: ({ seed, backend })
+#define NOISE_OP_VALUE          2       // params: ({ scale, seed, backend })
+#define NOISE_OP_FBM            3       // params: ({ scale, octaves, seed, backend })
+#define NOISE_OP_SCALE_BIAS     4       // inputs: ({ a }), params: ({ scale, bias })
+#define NOISE_OP_ADD            5       // inputs: ({ a, b })
+#define NOISE_OP_MULTIPLY       6       // inputs: ({ a, b })
+#define NOISE_OP_CLAMP          7       // inputs: ({ a }), params: ({ low, high })
+#define NOISE_OP_SELECT         8       // inputs: ({ control, low, high }), params: ({ threshold })
+
+// Graph layout
+#define NOISE_GRAPH_NODES       0       // mixed *: nodes by ID
+#define NOISE_GRAPH_OUTPUT      1       // int: output node ID, -1 if unset
+#define NOISE_GRAPH_PROGRAM     2       // mixed *: compiled program, 0 when stale
+#define NOISE_GRAPH_HASH        3       // string: content hash, 0 when stale
+#define NOISE_GRAPH_NODE_HASHES 4       // mixed *: per-node hashes, 0 when stale
+
+#define NOISE_GRAPH_FORMAT      "noisegraph2"
+#define NOISE_GRAPH_FORMAT_V1   "noisegraph1"   // Sources without a backend
+
+// Node layout
+#define NOISE_NODE_OP           0
+#define NOISE_NODE_INPUTS       1       // int *: input node IDs
+#define NOISE_NODE_PARAMS       2       // mixed *
+
+// Program layout
+#define NOISE_PROGRAM_CODE      0       // mixed *: instructions in execution order
+#define NOISE_PROGRAM_SLOTS     1       // int: temporaries needed
+#define NOISE_PROGRAM_RESULT    2       // int: slot holding the output
+
+// Instruction layout
+#define NOISE_INSTR_OP          0
+#define NOISE_INSTR_DEST        1       // int: slot written
+#define NOISE_INSTR_SOURCES     2       // int *: slots read
+#define NOISE_INSTR_PARAMS      3
+#define NOISE_INSTR_NODE        4       // int: node ID the instruction came from
+
+//--------------------------------------------------------------------------
+// Build a graph.  Each call returns the new node's ID.
+//
+mixed *NoiseGraphCreate();
+int NoiseGraphConst( mixed *graph, float value );
+int NoiseGraphWhite( mixed *graph, int seed );
+int NoiseGraphValue( mixed *graph, float scale, int seed );
+int NoiseGraphFbm( mixed *graph, float scale, int octaves, int seed );
+int NoiseGraphScaleBias( mixed *graph, int input, float scale, float bias );
+int NoiseGraphAdd( mixed *graph, int a, int b );
+int NoiseGraphMultiply( mixed *graph, int a, int b );
+int NoiseGraphClamp( mixed *graph, int input, float low, float high );
+int NoiseGraphSelect( mixed *graph, int control, int low, int high, float threshold );
+void NoiseGraphSetOutput( mixed *graph, int node );
+
+//--------------------------------------------------------------------------
+// Choose the hash backend (NOISE_BACKEND_*) of a white, value or fBm
+//  source.
+//
+void NoiseGraphSetBackend( mixed *graph, int node, int backend );
+
+//--------------------------------------------------------------------------
+// Compile (done on demand by NoiseGraphEvaluate) and evaluate over the
+//  width x height cells starting at (originX, originY).
+//
+mixed *NoiseGraphCompile( mixed *graph );
+float *NoiseGraphEvaluate( mixed *graph, int originX, int originY, int width, int height );
+
+//--------------------------------------------------------------------------
+// Serialization and content hashing.  NoiseGraphTile evaluates tile
+//  (tileX, tileY) of tileSize x tileSize cells through the tile cache.
+//
+string NoiseGraphSerialize( mixed *graph );
+mixed *NoiseGraphParse( string text );
+string NoiseGraphHash( mixed *graph );
+float *NoiseGraphTile( mixed *graph, int tileX, int tileY, int tileSize );
+
+//--------------------------------------------------------------------------
+// Parameter edits and incremental re-evaluation.  NoiseGraphSetParam sets
+//  parameter index of a node (in the order listed by NOISE_OP_*);
+//  NoiseGraphDependents lists the nodes downstream of a node.
+//
+void NoiseGraphSetParam( mixed *graph, int node, int index, mixed value );
+int *NoiseGraphDependents( mixed *graph, int node );
+float *NoiseGraphEvaluateIncremental( mixed *graph, int originX, int originY, int width, int height );
+
+//--------------------------------------------------------------------------
+// Evaluate only the cells selected by mask; returns ({ indices, values }).
+//
+mixed *NoiseGraphEvaluateMasked( mixed *graph, int originX, int originY, int width, int height, int *mask );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+mixed *NoiseGraphCreate()
+{
+	return ({ ({}), -1, 0, 0, ({}) });
+}
+
+//--------------------------------------------------------------------------
+private int noise_graph_add_node( mixed *graph, int op, int *inputs, mixed *params )
+{
+	int count = sizeof( graph[NOISE_GRAPH_NODES] );
+	int input;
+
+	foreach( input in inputs )
+		if( input < 0 || input >= count )
+			error( "NoiseGraph: unknown input node " + input + "\n" );
+
+	graph[NOISE_GRAPH_NODES] += ({ ({ op, inputs, params }) });
+	graph[NOISE_GRAPH_NODE_HASHES] += ({ 0 });
+	graph[NOISE_GRAPH_PROGRAM] = 0;
+	graph[NOISE_GRAPH_HASH] = 0;
+	return count;
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphConst( mixed *graph, float value )
+{
+	return noise_graph_add_node( graph, NOISE_OP_CONST, ({}), ({ to_float( value ) }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphWhite( mixed *graph, int seed )
+{
+	return noise_graph_add_node( graph, NOISE_OP_WHITE, ({}), ({ seed, NOISE_BACKEND_SQUIRREL5 }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphValue( mixed *graph, float scale, int seed )
+{
+	return noise_graph_add_node( graph, NOISE_OP_VALUE, ({}),
+		({ to_float( scale ), seed, NOISE_BACKEND_SQUIRREL5 }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphFbm( mixed *graph, float scale, int octaves, int seed )
+{
+	return noise_graph_add_node( graph, NOISE_OP_FBM, ({}),
+		({ to_float( scale ), octaves, seed, NOISE_BACKEND_SQUIRREL5 }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphScaleBias( mixed *graph, int input, float scale, float bias )
+{
+	return noise_graph_add_node( graph, NOISE_OP_SCALE_BIAS, ({ input }),
+		({ to_float( scale ), to_float( bias ) }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphAdd( mixed *graph, int a, int b )
+{
+	return noise_graph_add_node( graph, NOISE_OP_ADD, ({ a, b }), ({}) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphMultiply( mixed *graph, int a, int b )
+{
+	return noise_graph_add_node( graph, NOISE_OP_MULTIPLY, ({ a, b }), ({}) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphClamp( mixed *graph, int input, float low, float high )
+{
+	return noise_graph_add_node( graph, NOISE_OP_CLAMP, ({ input }),
+		({ to_float( low ), to_float( high ) }) );
+}
+
+//--------------------------------------------------------------------------
+int NoiseGraphSelect( mixed *graph, int control, int low, int high, float threshold )
+{
+	return noise_graph_add_node( graph, NOISE_OP_SELECT, ({ control, low, high }),
+		({ to_float( threshold ) }) );
+}
+
+//--------------------------------------------------------------------------
+void NoiseGraphSetOutput( mixed *graph, int node )
+{
+	if( node < 0 || node >= sizeof( graph[NOISE_GRAPH_NODES] ) )
+		error( "NoiseGraph: unknown output node " + node + "\n" );
+	graph[NOISE_GRAPH_OUTPUT] = node;
+	graph[NOISE_GRAPH_PROGRAM] = 0;
+	graph[NOISE_GRAPH_HASH] = 0;
+}
+
+//--------------------------------------------------------------------------
+// Flags for the nodes the output depends on (indexed up to the output).
+//  Inputs always have lower IDs, so one downward pass finds all of them.
+//
+private int *noise_graph_live( mixed *graph )
+{
+	mixed *nodes = graph[NOISE_GRAPH_NODES];
+	int output = graph[NOISE_GRAPH_OUTPUT];
+	int *live;
+	int id, input;
+
+	if( output < 0 )
+		error( "NoiseGraph: no output node set\n" );
+
+	live = allocate( output + 1 );
+	live[output] = 1;
+	for( id = output; id >= 0; id-- )
+		if( live[id] )
+			foreach( input in nodes[id][NOISE_NODE_INPUTS] )
+				live[input] = 1;
+	return live;
+}
+
+//--------------------------------------------------------------------------
+mixed *NoiseGraphCompile( mixed *graph )
+{
+	mixed *nodes = graph[NOISE_GRAPH_NODES];
+	int output = graph[NOISE_GRAPH_OUTPUT];
+	int *live, *lastUse, *slotOf, *freeSlots, *inputs, *sources;
+	mixed *code = ({});
+	int id, input, i, dest, slots;
+
+	live = noise_graph_live( graph );
+
+	lastUse = allocate( output + 1, -1 );
+	for( id = 0; id <= output; id++ )
+		if( live[id] )
+			foreach( input in nodes[id][NOISE_NODE_INPUTS] )
+				lastUse[input] = id;
+
+	// Every module is elementwise, so an input's slot can be handed to the
+	//  module reading it for the last time
+	slotOf = allocate( output + 1, -1 );
+	freeSlots = ({});
+	slots = 0;
+	for( id = 0; id <= output; id++ )
+	{
+		if( !live[id] )
+			continue;
+		inputs = nodes[id][NOISE_NODE_INPUTS];
+		sources = allocate( sizeof( inputs ) );
+		for( i = 0; i < sizeof( inputs ); i++ )
+			sources[i] = slotOf[ inputs[i] ];
+
+		foreach( input in inputs )
+			if( lastUse[input] == id && member_array( slotOf[input], freeSlots ) == -1 )
+				freeSlots += ({ slotOf[input] });
+
+		if( sizeof( freeSlots ) )
+		{
+			dest = freeSlots[<1];
+			freeSlots = freeSlots[0 .. <2];
+		}
+		else
+			dest = slots++;
+		slotOf[id] = dest;
+
+		code += ({ ({ nodes[id][NOISE_NODE_OP], dest, sources, nodes[id][NOISE_NODE_PARAMS], id }) });
+	}
+
+	graph[NOISE_GRAPH_PROGRAM] = ({ code, slots, slotOf[output] });
+	return graph[NOISE_GRAPH_PROGRAM];
+}
+
+//--------------------------------------------------------------------------
+// One source module at one cell; matches the dense fills exactly.
+//
+private float noise_graph_sample( int op, mixed *params, int posX, int posY )
+{
+	switch( op )
+	{
+		case NOISE_OP_CONST:
+			return params[0];
+		case NOISE_OP_WHITE:
+			return ( 1.0 * GetBackend2dNoise( params[1], posX, posY, params[0] ) ) / INT_32_UNSIGNED_MAX;
+		case NOISE_OP_VALUE:
+			return GetBackend2dValueNoise( params[2], posX * ( 1.0 / params[0] ),
+				posY * ( 1.0 / params[0] ), params[1] );
+		case NOISE_OP_FBM:
+			return GetBackend2dFbm( params[3], posX * ( 1.0 / params[0] ),
+				posY * ( 1.0 / params[0] ), params[1], params[2] );
+		default:
+			error( "NoiseGraph: not a source module " + op + "\n" );
+	}
+}
+
+//--------------------------------------------------------------------------
+// Run one instruction over a width x height block; slot arrays hold the
+//  block row-major with a stride of width.  If cells is given, only those
+//  block-local positions are evaluated and slots hold them packed.
+//
+private void noise_graph_run( mixed *instr, mixed *slots, int originX, int originY, int width, int height, int *cells )
+{
+	float *out = slots[ instr[NOISE_INSTR_DEST] ];
+	int *sources = instr[NOISE_INSTR_SOURCES];
+	mixed *params = instr[NOISE_INSTR_PARAMS];
+	int count = cells ? sizeof( cells ) : width * height;
+	float *a, *b, *c;
+	float scale, bias, low, high;
+	int *row;
+	int i, x, y, seed, backend;
+
+	if( cells && instr[NOISE_INSTR_OP] <= NOISE_OP_FBM )
+	{
+		for( i = 0; i < count; i++ )
+			out[i] = noise_graph_sample( instr[NOISE_INSTR_OP], params,
+				originX + cells[i] % width, originY + cells[i] / width );
+		return;
+	}
+
+	switch( instr[NOISE_INSTR_OP] )
+	{
+		case NOISE_OP_CONST:
+			low = params[0];
+			for( i = 0; i < count; i++ )
+				out[i] = low;
+			break;
+
+		case NOISE_OP_WHITE:
+			seed = params[0];
+			backend = params[1];
+			i = 0;
+			for( y = 0; y < height; y++ )
+			{
+				row = GetBackend2dNoiseRow( backend, originX, originY + y, width, seed );
+				for( x = 0; x < width; x++ )
+					out[i++] = ( 1.0 * row[x] ) / INT_32_UNSIGNED_MAX;
+			}
+			break;
+
+		case NOISE_OP_VALUE:
+			scale = 1.0 / params[0];
+			seed = params[1];
+			backend = params[2];
+			i = 0;
+			for( y = 0; y < height; y++ )
+				for( x = 0; x < width; x++ )
+					out[i++] = GetBackend2dValueNoise( backend, ( originX + x ) * scale, ( originY + y ) * scale, seed );
+			break;
+
+		case NOISE_OP_FBM:
+			// The grid fill shares lattice values across the block
+			a = GetBackend2dFbmGrid( params[3], originX, originY, width, height, params[0], params[1], params[2] );
+			for( i = 0; i < count; i++ )
+				out[i] = a[i];
+			break;
+
+		case NOISE_OP_SCALE_BIAS:
+			a = slots[ sources[0] ];
+			scale = params[0];
+			bias = params[1];
+			for( i = 0; i < count; i++ )
+				out[i] = a[i] * scale + bias;
+			break;
+
+		case NOISE_OP_ADD:
+			a = slots[ sources[0] ];
+			b = slots[ sources[1] ];
+			for( i = 0; i < count; i++ )
+				out[i] = a[i] + b[i];
+			break;
+
+		case NOISE_OP_MULTIPLY:
+			a = slots[ sources[0] ];
+			b = slots[ sources[1] ];
+			for( i = 0; i < count; i++ )
+				out[i] = a[i] * b[i];
+			break;
+
+		case NOISE_OP_CLAMP:
+			a = slots[ sources[0] ];
+			low = params[0];
+			high = params[1];
+			for( i = 0; i < count; i++ )
+				out[i] = a[i] < low ? low : ( a[i] > high ? high : a[i] );
+			break;
+
+		case NOISE_OP_SELECT:
+			a = slots[ sources[0] ];
+			b = slots[ sources[1] ];
+			c = slots[ sources[2] ];
+			low = params[0];
+			for( i = 0; i < count; i++ )
+				out[i] = a[i] >= low ? c[i] : b[i];
+			break;
+
+		default:
+			error( "NoiseGraph: unknown module kind " + instr[NOISE_INSTR_OP] + "\n" );
+	}
+}
+
+//--------------------------------------------------------------------------
+float *NoiseGraphEvaluate( mixed *graph, int originX, int originY, int width, int height )
+{
+	mixed *program = graph[NOISE_GRAPH_PROGRAM];
+	float *grid = allocate( width * height, 0.0 );
+	mixed *slots, *instr;
+	float *result;
+	int blockX, blockY, blockW, blockH, x, y, i;
+
+	if( !program )
+		program = NoiseGraphCompile( graph );
+
+	slots = allocate( program[NOISE_PROGRAM_SLOTS] );
+	for( i = 0; i < sizeof( slots ); i++ )
+		slots[i] = allocate( NOISE_GRAPH_BLOCK * NOISE_GRAPH_BLOCK, 0.0 );
+
+	for( blockY = 0; blockY < height; blockY += NOISE_GRAPH_BLOCK )
+	{
+		blockH = height - blockY < NOISE_GRAPH_BLOCK ? height - blockY : NOISE_GRAPH_BLOCK;
+		for( blockX = 0; blockX < width; blockX += NOISE_GRAPH_BLOCK )
+		{
+			blockW = width - blockX < NOISE_GRAPH_BLOCK ? width - blockX : NOISE_GRAPH_BLOCK;
+
+			foreach( instr in program[NOISE_PROGRAM_CODE] )
+				noise_graph_run( instr, slots, originX + blockX, originY + blockY, blockW, blockH, 0 );
+
+			result = slots[ program[NOISE_PROGRAM_RESULT] ];
+			i = 0;
+			for( y = 0; y < blockH; y++ )
+				for( x = 0; x < blockW; x++ )
+					grid[ ( blockY + y ) * width + blockX + x ] = result[i++];
+		}
+	}
+	return grid;
+}
+
+//--------------------------------------------------------------------------
+// Parameter types per module kind: 'f' float, 'i' int.
+//
+private string noise_graph_signature( int op )
+{
+	switch( op )
+	{
+		case NOISE_OP_CONST:            return "f";
+		case NOISE_OP_WHITE:            return "ii";
+		case NOISE_OP_VALUE:            return "fii";
+		case NOISE_OP_FBM:              return "fiii";
+		case NOISE_OP_SCALE_BIAS:       return "ff";
+		case NOISE_OP_ADD:              return "";
+		case NOISE_OP_MULTIPLY:         return "";
+		case NOISE_OP_CLAMP:            return "ff";
+		case NOISE_OP_SELECT:           return "f";
+		default:
+			error( "NoiseGraph: unknown module kind " + op + "\n" );
+	}
+}
+
+//--------------------------------------------------------------------------
+private string *noise_graph_param_fields( mixed *node )
+{
+	string signature = noise_graph_signature( node[NOISE_NODE_OP] );
+	string *fields = allocate( strlen( signature ) );
+	int i;
+
+	for( i = 0; i < strlen( signature ); i++ )
+		fields[i] = signature[i] == 'f' ? TileCacheEncodeFloat( node[NOISE_NODE_PARAMS][i] )
+			: sprintf( "%d", node[NOISE_NODE_PARAMS][i] );
+	return fields;
+}
+
+//--------------------------------------------------------------------------
+// Node IDs upstream of id, depth first with each node after its inputs.
+//  seen is shared across the walk so shared inputs are listed once.
+//
+private int *noise_graph_postorder( mixed *nodes, int id, int *seen )
+{
+	int *order = ({});
+	int input;
+
+	if( seen[id] )
+		return order;
+	seen[id] = 1;
+	foreach( input in nodes[id][NOISE_NODE_INPUTS] )
+		order += noise_graph_postorder( nodes, input, seen );
+	return order + ({ id });
+}
+
+//--------------------------------------------------------------------------
+string NoiseGraphSerialize( mixed *graph )
+{
+	mixed *nodes = graph[NOISE_GRAPH_NODES];
+	int output = graph[NOISE_GRAPH_OUTPUT];
+	string *parts = ({ NOISE_GRAPH_FORMAT });
+	int *renumber, *order;
+	string *fields;
+	mixed *node;
+	int id, input, count;
+
+	if( output < 0 )
+		error( "NoiseGraph: no output node set\n" );
+	order = noise_graph_postorder( nodes, output, allocate( output + 1 ) );
+	renumber = allocate( output + 1, -1 );
+
+	foreach( id in order )
+	{
+		node = nodes[id];
+		fields = ({ "" + node[NOISE_NODE_OP], "" + sizeof( node[NOISE_NODE_INPUTS] ) });
+		foreach( input in node[NOISE_NODE_INPUTS] )
+			fields += ({ "" + renumber[input] });
+
+		parts += ({ implode( fields + noise_graph_param_fields( node ), "," ) });
+		renumber[id] = count++;
+	}
+	return implode( parts, ";" );
+}
+
+//--------------------------------------------------------------------------
+mixed *NoiseGraphParse( string text )
+{
+	mixed *graph = NoiseGraphCreate();
+	string *parts = explode( text, ";" );
+	string *fields;
+	string signature;
+	int *inputs;
+	mixed *params;
+	int i, j, op, count, legacy;
+
+	if( !sizeof( parts ) || ( parts[0] != NOISE_GRAPH_FORMAT && parts[0] != NOISE_GRAPH_FORMAT_V1 ) )
+		error( "NoiseGraph: not a serialized noise graph\n" );
+	legacy = parts[0] == NOISE_GRAPH_FORMAT_V1;
+
+	for( i = 1; i < sizeof( parts ); i++ )
+	{
+		fields = explode( parts[i], "," );
+		if( sizeof( fields ) < 2 )
+			error( "NoiseGraph: malformed node " + parts[i] + "\n" );
+		op = to_int( fields[0] );
+		count = to_int( fields[1] );
+		signature = noise_graph_signature( op );
+
+		// Version 1 sources end before the backend; they used the default
+		if( legacy && op != NOISE_OP_CONST && op <= NOISE_OP_FBM )
+			fields += ({ "" + NOISE_BACKEND_SQUIRREL5 });
+		if( sizeof( fields ) != 2 + count + strlen( signature ) )
+			error( "NoiseGraph: malformed node " + parts[i] + "\n" );
+
+		inputs = allocate( count );
+		for( j = 0; j < count; j++ )
+			inputs[j] = to_int( fields[ 2 + j ] );
+		params = allocate( strlen( signature ) );
+		for( j = 0; j < strlen( signature ); j++ )
+			params[j] = signature[j] == 'f' ? TileCacheDecodeFloat( fields[ 2 + count + j ] )
+				: to_int( fields[ 2 + count + j ] );
+
+		noise_graph_add_node( graph, op, inputs, params );
+	}
+
+	if( sizeof( parts ) > 1 )
+		NoiseGraphSetOutput( graph, sizeof( parts ) - 2 );
+	return graph;
+}
+
+//--------------------------------------------------------------------------
+// Two independent 32-bit chains, so accidental collisions between designer
+//  graphs are out of the question in practice.
+//
+private string noise_graph_hash_text( string text )
+{
+	int low = 0x6A09E667;
+	int high = 0x3C6EF372;
+	int i;
+
+	for( i = 0; i < strlen( text ); i++ )
+	{
+		low = Get2dNoise( i, text[i], low );
+		high = Get2dNoise( text[i], i, high );
+	}
+	return sprintf( "%08x%08x", high, low );
+}
+
+//--------------------------------------------------------------------------
+string NoiseGraphHash( mixed *graph )
+{
+	if( !graph[NOISE_GRAPH_HASH] )
+		graph[NOISE_GRAPH_HASH] = noise_graph_hash_text( NoiseGraphSerialize( graph ) );
+	return graph[NOISE_GRAPH_HASH];
+}
+
+//--------------------------------------------------------------------------
+float *NoiseGraphTile( mixed *graph, int tileX, int tileY, int tileSize )
+{
+	string key = TileCacheKey( sprintf( "graph/%s/%d", NoiseGraphHash( graph ), tileSize ),
+		tileX, tileY, 0 );
+
+	return TileCacheFetch( key,
+		(: NoiseGraphEvaluate, graph, tileX * tileSize, tileY * tileSize, tileSize, tileSize :) );
+}
+
+//--------------------------------------------------------------------------
+int *NoiseGraphDependents( mixed *graph, int node )
+{
+	mixed *nodes = graph[NOISE_GRAPH_NODES];
+	int *dirty = allocate( sizeof( nodes ) );
+	int *dependents = ({});
+	int id, input;
+
+	// Dependents always have higher IDs, so one upward pass finds them all
+	dirty[node] = 1;
+	for( id = node + 1; id < sizeof( nodes ); id++ )
+	{
+		foreach( input in nodes[id][NOISE_NODE_INPUTS] )
+		{
+			if( dirty[input] )
+			{
+				dirty[id] = 1;
+				dependents += ({ id });
+				break;
+			}
+		}
+	}
+	return dependents;
+}
+
+//--------------------------------------------------------------------------
+void NoiseGraphSetParam( mixed *graph, int node, int index, mixed value )
+{
+	mixed *params;
+	string signature;
+	int id;
+
+	if( node < 0 || node >= sizeof( graph[NOISE_GRAPH_NODES] ) )
+		error( "NoiseGraph: unknown node " + node + "\n" );
+	params = graph[NOISE_GRAPH_NODES][node][NOISE_NODE_PARAMS];
+	signature = noise_graph_signature( graph[NOISE_GRAPH_NODES][node][NOISE_NODE_OP] );
+	if( index < 0 || index >= strlen( signature ) )
+		error( "NoiseGraph: node " + node + " has no parameter " + index + "\n" );
+
+	// The compiled program shares this array, so it stays valid
+	params[index] = signature[index] == 'f' ? to_float( value ) : to_int( value );
+
+	graph[NOISE_GRAPH_HASH] = 0;
+	graph[NOISE_GRAPH_NODE_HASHES][node] = 0;
+	foreach( id in NoiseGraphDependents( graph, node ) )
+		graph[NOISE_GRAPH_NODE_HASHES][id] = 0;
+}
+
+//--------------------------------------------------------------------------
+void NoiseGraphSetBackend( mixed *graph, int node, int backend )
+{
+	int op;
+
+	if( node < 0 || node >= sizeof( graph[NOISE_GRAPH_NODES] ) )
+		error( "NoiseGraph: unknown node " + node + "\n" );
+	op = graph[NOISE_GRAPH_NODES][node][NOISE_NODE_OP];
+	if( op == NOISE_OP_CONST || op > NOISE_OP_FBM )
+		error( "NoiseGraph: node " + node + " is not a noise source\n" );
+	if( backend < 0 || backend >= NOISE_BACKEND_COUNT )
+		error( "NoiseGraph: unknown backend " + backend + "\n" );
+
+	// The backend is always a source's last parameter
+	NoiseGraphSetParam( graph, node, strlen( noise_graph_signature( op ) ) - 1, backend );
+}
+
+//--------------------------------------------------------------------------
+// Hash of a node and everything upstream of it.  Input hashes are always
+//  computed first, as inputs have lower IDs.
+//
+private string noise_graph_node_hash( mixed *graph, int id )
+{
+	mixed *hashes = graph[NOISE_GRAPH_NODE_HASHES];
+	mixed *node = graph[NOISE_GRAPH_NODES][id];
+	string *fields;
+	int input;
+
+	if( !hashes[id] )
+	{
+		fields = ({ "" + node[NOISE_NODE_OP] }) + noise_graph_param_fields( node );
+		foreach( input in node[NOISE_NODE_INPUTS] )
+			fields += ({ noise_graph_node_hash( graph, input ) });
+		hashes[id] = noise_graph_hash_text( implode( fields, "," ) );
+	}
+	return hashes[id];
+}
+
+//--------------------------------------------------------------------------
+float *NoiseGraphEvaluateIncremental( mixed *graph, int originX, int originY, int width, int height )
+{
+	mixed *nodes = graph[NOISE_GRAPH_NODES];
+	int *live = noise_graph_live( graph );
+	mixed *results = allocate( sizeof( live ) );
+	mixed *node;
+	string key;
+	int id;
+
+	for( id = 0; id < sizeof( live ); id++ )
+	{
+		if( !live[id] )
+			continue;
+		key = TileCacheKey( sprintf( "graphnode/%s/%d/%d", noise_graph_node_hash( graph, id ),
+			width, height ), originX, originY, 0 );
+		results[id] = TileCacheGet( key );
+		if( results[id] )
+			continue;
+
+		// Results are indexed by node ID, so the node's inputs are its slots
+		node = nodes[id];
+		results[id] = allocate( width * height, 0.0 );
+		noise_graph_run( ({ node[NOISE_NODE_OP], id, node[NOISE_NODE_INPUTS], node[NOISE_NODE_PARAMS], id }),
+			results, originX, originY, width, height, 0 );
+		TileCacheSet( key, results[id] );
+	}
+
+	// Copy, so callers can modify the grid without touching the cache
+	return results[<1] + ({});
+}
+
+//--------------------------------------------------------------------------
+mixed *NoiseGraphEvaluateMasked( mixed *graph, int originX, int originY, int width, int height, int *mask )
+{
+	mixed *program = graph[NOISE_GRAPH_PROGRAM];
+	int rowWords = CaRowWords( width );
+	int *indices = SparseMaskIndices( mask, width, height );
+	float *values = allocate( sizeof( indices ), 0.0 );
+	mixed *slots, *instr;
+	float *band, *result;
+	int *cells;
+	int blockX, blockY, blockW, blockH, x, y, i, bits, next;
+
+	if( !program )
+		program = NoiseGraphCompile( graph );
+
+	slots = allocate( program[NOISE_PROGRAM_SLOTS] );
+	for( i = 0; i < sizeof( slots ); i++ )
+		slots[i] = allocate( NOISE_GRAPH_BLOCK * NOISE_GRAPH_BLOCK, 0.0 );
+
+	for( blockY = 0; blockY < height; blockY += NOISE_GRAPH_BLOCK )
+	{
+		blockH = height - blockY < NOISE_GRAPH_BLOCK ? height - blockY : NOISE_GRAPH_BLOCK;
+		band = allocate( width * blockH, 0.0 );
+
+		for( blockX = 0; blockX < width; blockX += NOISE_GRAPH_BLOCK )
+		{
+			blockW = width - blockX < NOISE_GRAPH_BLOCK ? width - blockX : NOISE_GRAPH_BLOCK;
+
+			cells = ({});
+			for( y = 0; y < blockH; y++ )
+			{
+				bits = sparse_block_bits( mask, rowWords, blockX, blockY + y, blockW );
+				for( x = 0; bits; x++, bits >>= 1 )
+					if( bits & 1 )
+						cells += ({ y * blockW + x });
+			}
+			if( !sizeof( cells ) )
+				continue;
+			if( sizeof( cells ) >= SPARSE_DENSE_FILL * blockW * blockH )
+				cells = 0;
+
+			foreach( instr in program[NOISE_PROGRAM_CODE] )
+				noise_graph_run( instr, slots, originX + blockX, originY + blockY, blockW, blockH, cells );
+
+			result = slots[ program[NOISE_PROGRAM_RESULT] ];
+			if( cells )
+			{
+				for( i = 0; i < sizeof( cells ); i++ )
+					band[ ( cells[i] / blockW ) * width + blockX + cells[i] % blockW ] = result[i];
+			}
+			else
+			{
+				i = 0;
+				for( y = 0; y < blockH; y++ )
+					for( x = 0; x < blockW; x++ )
+						band[ y * width + blockX + x ] = result[i++];
+			}
+		}
+
+		// Compact the band in row-major order, matching the indices
+		while( next < sizeof( indices ) && indices[next] < ( blockY + blockH ) * width )
+		{
+			values[next] = band[ indices[next] - blockY * width ];
+			next++;
+		}
+	}
+	return ({ indices, values });
+}
+
+#endif
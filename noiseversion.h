@@ -0,0 +1,160 @@
+// noiseversion.h
+// Seed manifests and side-by-side noise algorithm versions
+// Built on noise.h (SquirrelNoise5)
+
+#ifndef _NOISEVERSION_H
+#define _NOISEVERSION_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Noise versions
+//
+// Anything long-lived that was derived from noise (saved worlds, cached
+//  tiles, seed manifests) must record which algorithm produced it, or a
+//  change to a hash constant or prime silently invalidates it.  noise.h
+//  exposes NoiseAlgorithmId() for that; this file adds:
+//
+//  - seed manifests: a mapping recording the seed, algorithm ID and any
+//    caller data, plus a compatibility check for when it is loaded back;
+//  - a registry of algorithm versions, so that during a migration the old
+//    algorithm can keep running next to the new one.  When noise.h changes,
+//    copy the old raw hash into a frozen function and register it under
+//    the old ID with its primes; NoiseVersioned*dNoise then reproduce the
+//    old values for conversion.  The running algorithm is always registered
+//    under its own ID.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Registry entry layout
+#define NOISE_VERSION_HASH      0       // function: raw( index, seed )
+#define NOISE_VERSION_PRIMES    1       // int *: primes for the Y, Z and T axes
+
+//--------------------------------------------------------------------------
+// Seed manifests.
+//
+mapping NoiseManifest( int seed, mapping data );
+int NoiseManifestIsCurrent( mapping manifest );
+
+//--------------------------------------------------------------------------
+// Version registry.
+//
+void NoiseRegisterVersion( string algorithm, function raw, int *primes );
+int NoiseHasVersion( string algorithm );
+string *NoiseVersions();
+
+//--------------------------------------------------------------------------
+// Raw noise from a specific registered algorithm.
+//
+int NoiseVersioned1dNoise( string algorithm, int index, int seed );
+int NoiseVersioned2dNoise( string algorithm, int posX, int posY, int seed );
+int NoiseVersioned3dNoise( string algorithm, int posX, int posY, int posZ, int seed );
+int NoiseVersioned4dNoise( string algorithm, int posX, int posY, int posZ, int posT, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// algorithm ID -> ({ raw hash, primes })
+nosave private mapping noise_versions;
+
+//--------------------------------------------------------------------------
+private mapping noise_version_registry()
+{
+	if( !noise_versions )
+	{
+		noise_versions = ([
+			NoiseAlgorithmId() : ({ (: Get1dNoise :), ({ NOISE_PRIME_Y, NOISE_PRIME_Z, NOISE_PRIME_T }) }),
+		]);
+	}
+	return noise_versions;
+}
+
+//--------------------------------------------------------------------------
+private mixed *noise_version_entry( string algorithm )
+{
+	mixed *entry = noise_version_registry()[algorithm];
+
+	if( !entry )
+		error( "Unknown noise algorithm version: " + algorithm + "\n" );
+	return entry;
+}
+
+//--------------------------------------------------------------------------
+mapping NoiseManifest( int seed, mapping data )
+{
+	return ([
+		"algorithm" : NoiseAlgorithmId(),
+		"name" : NOISE_ALGORITHM_NAME,
+		"version" : NOISE_ALGORITHM_VERSION,
+		"fingerprint" : NoiseAlgorithmFingerprint(),
+		"seed" : seed,
+		"data" : data ? data : ([]),
+	]);
+}
+
+//--------------------------------------------------------------------------
+int NoiseManifestIsCurrent( mapping manifest )
+{
+	return mapp( manifest ) && manifest["algorithm"] == NoiseAlgorithmId();
+}
+
+//--------------------------------------------------------------------------
+void NoiseRegisterVersion( string algorithm, function raw, int *primes )
+{
+	noise_version_registry()[algorithm] = ({ raw, primes });
+}
+
+//--------------------------------------------------------------------------
+int NoiseHasVersion( string algorithm )
+{
+	return !undefinedp( noise_version_registry()[algorithm] );
+}
+
+//--------------------------------------------------------------------------
+string *NoiseVersions()
+{
+	return keys( noise_version_registry() );
+}
+
+//--------------------------------------------------------------------------
+int NoiseVersioned1dNoise( string algorithm, int index, int seed )
+{
+	return evaluate( noise_version_entry( algorithm )[NOISE_VERSION_HASH], index, seed );
+}
+
+//--------------------------------------------------------------------------
+int NoiseVersioned2dNoise( string algorithm, int posX, int posY, int seed )
+{
+	mixed *entry = noise_version_entry( algorithm );
+	int *primes = entry[NOISE_VERSION_PRIMES];
+
+	return evaluate( entry[NOISE_VERSION_HASH], posX
+		+ fake_uint32_overflow( primes[0] * posY ), seed );
+}
+
+//--------------------------------------------------------------------------
+int NoiseVersioned3dNoise( string algorithm, int posX, int posY, int posZ, int seed )
+{
+	mixed *entry = noise_version_entry( algorithm );
+	int *primes = entry[NOISE_VERSION_PRIMES];
+
+	return evaluate( entry[NOISE_VERSION_HASH], posX
+		+ fake_uint32_overflow( primes[0] * posY )
+		+ fake_uint32_overflow( primes[1] * posZ ), seed );
+}
+
+//--------------------------------------------------------------------------
+int NoiseVersioned4dNoise( string algorithm, int posX, int posY, int posZ, int posT, int seed )
+{
+	mixed *entry = noise_version_entry( algorithm );
+	int *primes = entry[NOISE_VERSION_PRIMES];
+
+	return evaluate( entry[NOISE_VERSION_HASH], posX
+		+ fake_uint32_overflow( primes[0] * posY )
+		+ fake_uint32_overflow( primes[1] * posZ )
+		+ fake_uint32_overflow( primes[2] * posT ), seed );
+}
+
+#endif
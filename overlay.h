@@ -0,0 +1,192 @@
+// overlay.h
+// Sparse copy-on-write overlay of edits over procedural terrain
+// Built for use with noise.h (SquirrelNoise5) generators
+
+#ifndef _OVERLAY_H
+#define _OVERLAY_H
+
+////////////////////////////////////////////////////////////////////////////
+// Terrain overlay
+//
+// Procedural terrain is immutable; player edits (dug tunnels, built walls)
+//  are recorded in an overlay that only stores the cells that changed.
+//
+// The overlay is a mapping of 32 x 32 chunks keyed by a packed integer
+//  chunk coordinate.  Each chunk has a bitmap with one word per row marking
+//  the modified cells, and a value array for those cells.  Areas nobody
+//  touched have no chunk at all, so reading them costs a single mapping
+//  miss before falling back to the base generator, and merging skips them
+//  entirely.  Emptied chunks are released.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define OVERLAY_CHUNK_BITS      5
+#define OVERLAY_CHUNK_SIZE      ( 1 << OVERLAY_CHUNK_BITS )
+#define OVERLAY_CHUNK_MASK      ( OVERLAY_CHUNK_SIZE - 1 )
+
+// Chunk layout
+#define OVERLAY_CHUNK_ROWS      0       // int *: modified bits, one word per row
+#define OVERLAY_CHUNK_VALUES    1       // mixed *: row-major values
+#define OVERLAY_CHUNK_COUNT     2       // int: modified cells in the chunk
+
+//--------------------------------------------------------------------------
+// Create an overlay and record or undo edits.
+//
+mapping OverlayCreate();
+void OverlaySet( mapping overlay, int posX, int posY, mixed value );
+void OverlayRevert( mapping overlay, int posX, int posY );
+
+//--------------------------------------------------------------------------
+// Reads.  OverlayRead returns the edited value, or base( x, y ) for cells
+//  that were never edited.
+//
+int OverlayIsModified( mapping overlay, int posX, int posY );
+mixed OverlayRead( mapping overlay, int posX, int posY, function base );
+
+//--------------------------------------------------------------------------
+// Write all edits inside the region into a generated row-major grid of
+//  width x height cells starting at (originX, originY), in place.
+//
+void OverlayMergeGrid( mapping overlay, mixed *grid, int originX, int originY, int width, int height );
+
+//--------------------------------------------------------------------------
+// Total number of edited cells.
+//
+int OverlayCount( mapping overlay );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private int overlay_chunk_key( int chunkX, int chunkY )
+{
+	return ( ( chunkX & 0xFFFFFFFF ) << 32 ) | ( chunkY & 0xFFFFFFFF );
+}
+
+//--------------------------------------------------------------------------
+mapping OverlayCreate()
+{
+	return ([]);
+}
+
+//--------------------------------------------------------------------------
+void OverlaySet( mapping overlay, int posX, int posY, mixed value )
+{
+	int key = overlay_chunk_key( posX >> OVERLAY_CHUNK_BITS, posY >> OVERLAY_CHUNK_BITS );
+	int localX = posX & OVERLAY_CHUNK_MASK;
+	int localY = posY & OVERLAY_CHUNK_MASK;
+	mixed *chunk = overlay[key];
+
+	if( !chunk )
+	{
+		chunk = ({ allocate( OVERLAY_CHUNK_SIZE ),
+			allocate( OVERLAY_CHUNK_SIZE * OVERLAY_CHUNK_SIZE ), 0 });
+		overlay[key] = chunk;
+	}
+
+	if( !( chunk[OVERLAY_CHUNK_ROWS][localY] & ( 1 << localX ) ) )
+	{
+		chunk[OVERLAY_CHUNK_ROWS][localY] |= 1 << localX;
+		chunk[OVERLAY_CHUNK_COUNT]++;
+	}
+	chunk[OVERLAY_CHUNK_VALUES][ ( localY << OVERLAY_CHUNK_BITS ) | localX ] = value;
+}
+
+//--------------------------------------------------------------------------
+void OverlayRevert( mapping overlay, int posX, int posY )
+{
+	int key = overlay_chunk_key( posX >> OVERLAY_CHUNK_BITS, posY >> OVERLAY_CHUNK_BITS );
+	int localX = posX & OVERLAY_CHUNK_MASK;
+	int localY = posY & OVERLAY_CHUNK_MASK;
+	mixed *chunk = overlay[key];
+
+	if( !chunk || !( chunk[OVERLAY_CHUNK_ROWS][localY] & ( 1 << localX ) ) )
+		return;
+
+	if( !--chunk[OVERLAY_CHUNK_COUNT] )
+	{
+		map_delete( overlay, key );
+		return;
+	}
+	chunk[OVERLAY_CHUNK_ROWS][localY] &= ~( 1 << localX );
+	chunk[OVERLAY_CHUNK_VALUES][ ( localY << OVERLAY_CHUNK_BITS ) | localX ] = 0;
+}
+
+//--------------------------------------------------------------------------
+int OverlayIsModified( mapping overlay, int posX, int posY )
+{
+	mixed *chunk = overlay[ overlay_chunk_key( posX >> OVERLAY_CHUNK_BITS, posY >> OVERLAY_CHUNK_BITS ) ];
+
+	if( !chunk )
+		return 0;
+	return ( chunk[OVERLAY_CHUNK_ROWS][ posY & OVERLAY_CHUNK_MASK ] >> ( posX & OVERLAY_CHUNK_MASK ) ) & 1;
+}
+
+//--------------------------------------------------------------------------
+mixed OverlayRead( mapping overlay, int posX, int posY, function base )
+{
+	mixed *chunk = overlay[ overlay_chunk_key( posX >> OVERLAY_CHUNK_BITS, posY >> OVERLAY_CHUNK_BITS ) ];
+	int localX = posX & OVERLAY_CHUNK_MASK;
+	int localY = posY & OVERLAY_CHUNK_MASK;
+
+	if( chunk && ( chunk[OVERLAY_CHUNK_ROWS][localY] & ( 1 << localX ) ) )
+		return chunk[OVERLAY_CHUNK_VALUES][ ( localY << OVERLAY_CHUNK_BITS ) | localX ];
+	return evaluate( base, posX, posY );
+}
+
+//--------------------------------------------------------------------------
+void OverlayMergeGrid( mapping overlay, mixed *grid, int originX, int originY, int width, int height )
+{
+	int chunkX, chunkY, localX, localY, row, bits, x, y;
+	int *rows;
+	mixed *chunk, *cells;
+
+	if( !sizeof( overlay ) || width <= 0 || height <= 0 )
+		return;
+
+	for( chunkY = originY >> OVERLAY_CHUNK_BITS; chunkY <= ( originY + height - 1 ) >> OVERLAY_CHUNK_BITS; chunkY++ )
+	{
+		for( chunkX = originX >> OVERLAY_CHUNK_BITS; chunkX <= ( originX + width - 1 ) >> OVERLAY_CHUNK_BITS; chunkX++ )
+		{
+			chunk = overlay[ overlay_chunk_key( chunkX, chunkY ) ];
+			if( !chunk )
+				continue;
+			rows = chunk[OVERLAY_CHUNK_ROWS];
+			cells = chunk[OVERLAY_CHUNK_VALUES];
+
+			for( localY = 0; localY < OVERLAY_CHUNK_SIZE; localY++ )
+			{
+				y = ( chunkY << OVERLAY_CHUNK_BITS ) + localY - originY;
+				if( !rows[localY] || y < 0 || y >= height )
+					continue;
+
+				// Walk only the set bits of the row
+				bits = rows[localY];
+				row = localY << OVERLAY_CHUNK_BITS;
+				for( localX = 0; bits; localX++, bits >>= 1 )
+				{
+					if( !( bits & 1 ) )
+						continue;
+					x = ( chunkX << OVERLAY_CHUNK_BITS ) + localX - originX;
+					if( x >= 0 && x < width )
+						grid[ y * width + x ] = cells[ row | localX ];
+				}
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+int OverlayCount( mapping overlay )
+{
+	mixed *chunk;
+	int total = 0;
+
+	foreach( chunk in values( overlay ) )
+		total += chunk[OVERLAY_CHUNK_COUNT];
+	return total;
+}
+
+#endif
@@ -0,0 +1,234 @@
+// rivers.h
+// Drainage, flow accumulation and river masks over noise terrain
+// Built on noise.h (SquirrelNoise5), valuenoise.h and tilecache.h
+
+#ifndef _RIVERS_H
+#define _RIVERS_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "cellular.h"
+#include "tilecache.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Rivers
+//
+// RiverComputeFlow runs a priority flood over a heightmap: cells are
+//  visited from the map edge inwards in order of increasing (filled)
+//  height.  A cell first reached from a lower neighbor drains into that
+//  neighbor, and pits are raised to just above their spill point, so every
+//  cell ends up with a receiver and all water reaches the edge.  Visiting
+//  cells in reverse order then accumulates upstream area in one pass.  Ties
+//  are broken by cell index, so results depend only on the heightmap.
+//
+// Tiles are computed from a tile plus a halo of fBm terrain, so each tile
+//  stands on its own (tiles can be processed in any order and share
+//  nothing).  Catchments larger than the halo are cut off at its edge; for
+//  continent-scale rivers, #define RIVER_HALO larger before including this
+//  file.  Tile results are kept in the tile cache under the "river" kind,
+//  keyed with the halo so tiles made with different halos never mix.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef RIVER_HALO
+#define RIVER_HALO              64      // Extra cells of terrain around a tile
+#endif
+#define RIVER_EPSILON           0.00001 // Slope added across filled pits
+
+// Indices into the array returned by RiverComputeFlow / RiverTile
+#define RIVER_FILLED            0       // float *: depression-filled heights
+#define RIVER_RECEIVER          1       // int *: downstream cell, -1 drains off the map
+#define RIVER_FLOW              2       // int *: upstream cell count, including itself
+#define RIVER_MASK              3       // int *: cellular.h bitmap, set where flow >= threshold
+
+//--------------------------------------------------------------------------
+// Flow over a row-major width x height heightmap.  Returns
+//  ({ filled, receivers, flow, mask }).
+//
+mixed *RiverComputeFlow( float *heights, int width, int height, int threshold );
+
+//--------------------------------------------------------------------------
+// Flow for one tileSize x tileSize tile of Get2dFbmGrid terrain, cached.
+//
+mixed *RiverTile( int tileX, int tileY, int tileSize, float scale, int octaves, int threshold, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+// Binary min-heap of cell indices ordered by (keys[cell], cell).
+//
+private int river_before( float *keys, int a, int b )
+{
+	return keys[a] < keys[b] || ( keys[a] == keys[b] && a < b );
+}
+
+//--------------------------------------------------------------------------
+private int river_heap_push( int *heap, int size, float *keys, int cell )
+{
+	int i = size;
+	int parent;
+
+	while( i > 0 )
+	{
+		parent = ( i - 1 ) / 2;
+		if( !river_before( keys, cell, heap[parent] ) )
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = cell;
+	return size + 1;
+}
+
+//--------------------------------------------------------------------------
+// Removes heap[0]; the caller reads it first.  Returns the new size.
+//
+private int river_heap_pop( int *heap, int size, float *keys )
+{
+	int last = heap[--size];
+	int i = 0;
+	int child;
+
+	while( ( child = 2 * i + 1 ) < size )
+	{
+		if( child + 1 < size && river_before( keys, heap[child + 1], heap[child] ) )
+			child++;
+		if( !river_before( keys, heap[child], last ) )
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	if( size > 0 )
+		heap[i] = last;
+	return size;
+}
+
+//--------------------------------------------------------------------------
+mixed *RiverComputeFlow( float *heights, int width, int height, int threshold )
+{
+	int cells = width * height;
+	float *filled = copy( heights );
+	int *receivers = allocate( cells, -1 );
+	int *flow = allocate( cells, 1 );
+	int *mask = allocate( CaRowWords( width ) * height );
+	int *visited = allocate( cells );
+	int *order = allocate( cells );
+	int *heap = allocate( cells );
+	int size = 0;
+	int visits = 0;
+	int cell, next, x, y, dx, dy, nx, ny;
+
+	// The map edge drains off the map
+	for( y = 0; y < height; y++ )
+	{
+		for( x = 0; x < width; x++ )
+		{
+			if( x == 0 || y == 0 || x == width - 1 || y == height - 1 )
+			{
+				cell = y * width + x;
+				visited[cell] = 1;
+				size = river_heap_push( heap, size, filled, cell );
+			}
+		}
+	}
+
+	while( size > 0 )
+	{
+		cell = heap[0];
+		size = river_heap_pop( heap, size, filled );
+		order[visits++] = cell;
+		x = cell % width;
+		y = cell / width;
+
+		for( dy = -1; dy <= 1; dy++ )
+		{
+			for( dx = -1; dx <= 1; dx++ )
+			{
+				nx = x + dx;
+				ny = y + dy;
+				if( ( !dx && !dy ) || nx < 0 || ny < 0 || nx >= width || ny >= height )
+					continue;
+				next = ny * width + nx;
+				if( visited[next] )
+					continue;
+				visited[next] = 1;
+				receivers[next] = cell;
+				if( filled[next] < filled[cell] + RIVER_EPSILON )
+					filled[next] = filled[cell] + RIVER_EPSILON;
+				size = river_heap_push( heap, size, filled, next );
+			}
+		}
+	}
+
+	// Highest first: every cell is finished before its receiver
+	for( visits = cells - 1; visits >= 0; visits-- )
+	{
+		cell = order[visits];
+		if( receivers[cell] >= 0 )
+			flow[ receivers[cell] ] += flow[cell];
+	}
+
+	for( cell = 0; cell < cells; cell++ )
+		if( flow[cell] >= threshold )
+			CaSetCell( mask, width, height, cell % width, cell / width, 1 );
+
+	return ({ filled, receivers, flow, mask });
+}
+
+//--------------------------------------------------------------------------
+private mixed *river_build_tile( int tileX, int tileY, int tileSize, float scale, int octaves, int threshold, int seed )
+{
+	int span = tileSize + 2 * RIVER_HALO;
+	float *heights;
+	mixed *result;
+	float *filled = allocate( tileSize * tileSize, 0.0 );
+	int *receivers = allocate( tileSize * tileSize );
+	int *flow = allocate( tileSize * tileSize );
+	int *mask = allocate( CaRowWords( tileSize ) * tileSize );
+	int x, y, rx, ry, from, to, receiver;
+
+	heights = Get2dFbmGrid( tileX * tileSize - RIVER_HALO, tileY * tileSize - RIVER_HALO,
+		span, span, scale, octaves, seed );
+	result = RiverComputeFlow( heights, span, span, threshold );
+
+	// Crop to the interior; receivers are re-expressed in tile cells, with
+	//  -1 for water leaving the tile
+	for( y = 0; y < tileSize; y++ )
+	{
+		for( x = 0; x < tileSize; x++ )
+		{
+			from = ( y + RIVER_HALO ) * span + x + RIVER_HALO;
+			to = y * tileSize + x;
+			filled[to] = result[RIVER_FILLED][from];
+			flow[to] = result[RIVER_FLOW][from];
+			receiver = result[RIVER_RECEIVER][from];
+			receivers[to] = -1;
+			if( receiver >= 0 )
+			{
+				rx = receiver % span - RIVER_HALO;
+				ry = receiver / span - RIVER_HALO;
+				if( rx >= 0 && ry >= 0 && rx < tileSize && ry < tileSize )
+					receivers[to] = ry * tileSize + rx;
+			}
+			if( flow[to] >= threshold )
+				CaSetCell( mask, tileSize, tileSize, x, y, 1 );
+		}
+	}
+	return ({ filled, receivers, flow, mask });
+}
+
+//--------------------------------------------------------------------------
+mixed *RiverTile( int tileX, int tileY, int tileSize, float scale, int octaves, int threshold, int seed )
+{
+	string key = TileCacheKey( sprintf( "river/%d/%d/%s/%d/%d", RIVER_HALO, tileSize,
+		TileCacheEncodeFloat( scale ), octaves, threshold ),
+		tileX, tileY, seed );
+
+	return TileCacheFetch( key,
+		(: river_build_tile, tileX, tileY, tileSize, scale, octaves, threshold, seed :) );
+}
+
+#endif
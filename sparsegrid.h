@@ -0,0 +1,223 @@
+// sparsegrid.h
+// Mask-driven sparse evaluation of noise grids and volumes
+// Built on noise.h (SquirrelNoise5), valuenoise.h (fBm) and cellular.h
+//  (bitmap layout)
+
+#ifndef _SPARSEGRID_H
+#define _SPARSEGRID_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "cellular.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Sparse grids
+//
+// Detail noise is wasted on cells nobody will look at (solid rock, deep
+//  ocean).  The functions here take a mask and only evaluate the cells it
+//  selects, so the cost follows the interesting area rather than the grid.
+//
+// Masks use the cellular.h bitmap layout: CaRowWords(width) words per row,
+//  bit set = evaluate the cell.  A volume mask is one such bitmap per layer,
+//  concatenated, so row y of layer z is row (z * height + y).
+//
+// Output is compacted: ({ int *indices, float *values }), where indices are
+//  row-major positions in the full grid (z * width * height + y * width + x
+//  for volumes) in ascending order, and values[i] belongs to indices[i].
+//  Values are identical to what the dense Get2dFbmGrid / Get3dFbm would
+//  give for those cells.
+//
+// Sparse 2D fBm works in SPARSE_BLOCK square blocks.  Empty blocks are
+//  skipped; a block with at least SPARSE_DENSE_FILL of its cells selected
+//  is filled with Get2dFbmGrid, whose shared lattice costs less than four
+//  hashes per octave per cell, and only sparser blocks sample cell by cell.
+//
+// SparseMaskFromCoarse builds a mask from a cheap test: predicate( x, y )
+//  is called at every step-th cell in each direction, and a step x step
+//  cell is selected when any of its four corners passes.  Features smaller
+//  than step that fall entirely between corners are missed, so the
+//  predicate should be generous (test "could be land", not "is land").
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Compacted output layout
+#define SPARSE_INDICES          0       // int *
+#define SPARSE_VALUES           1       // float *
+
+#define SPARSE_BLOCK            16      // Cells per side of a 2D block; must divide 32
+#define SPARSE_DENSE_FILL       0.25    // Selected fraction above which a block is filled densely
+
+//--------------------------------------------------------------------------
+// Masks.
+//
+int *SparseMaskFromCoarse( int originX, int originY, int width, int height, int step, function predicate );
+int SparseMaskCount( int *mask );
+int *SparseMaskIndices( int *mask, int width, int rows );
+
+//--------------------------------------------------------------------------
+// Sparse fBm over a width x height grid, or a width x height x depth
+//  volume, starting at the origin cell; sampled at (cell / scale) like
+//  Get2dFbmGrid.
+//
+mixed *Get2dFbmGridSparse( int originX, int originY, int width, int height, float scale, int octaves, int seed, int *mask );
+mixed *Get3dFbmVolumeSparse( int originX, int originY, int originZ, int width, int height, int depth, float scale, int octaves, int seed, int *mask );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+// Mask bits of one block row, cell blockX first.  Blocks never straddle a
+//  mask word, so this is one shifted slice of a word.
+//
+private int sparse_block_bits( int *mask, int rowWords, int blockX, int row, int blockW )
+{
+	return ( mask[ row * rowWords + blockX / CA_BITS_PER_WORD ]
+		>> ( blockX % CA_BITS_PER_WORD ) ) & ( ( 1 << blockW ) - 1 );
+}
+
+//--------------------------------------------------------------------------
+int *SparseMaskFromCoarse( int originX, int originY, int width, int height, int step, function predicate )
+{
+	int rowWords = CaRowWords( width );
+	int *mask = allocate( rowWords * height );
+	int coarseW = ( width + step - 1 ) / step;
+	int coarseH = ( height + step - 1 ) / step;
+	int *passed = allocate( ( coarseW + 1 ) * ( coarseH + 1 ) );
+	int *row;
+	int i, j, x, y, end, index;
+
+	// Corner tests, shared by the up to four coarse cells around each
+	for( j = 0; j <= coarseH; j++ )
+		for( i = 0; i <= coarseW; i++ )
+			passed[ j * ( coarseW + 1 ) + i ] =
+				evaluate( predicate, originX + i * step, originY + j * step ) ? 1 : 0;
+
+	for( j = 0; j < coarseH; j++ )
+	{
+		// All rows of a coarse band are the same; build one and copy it
+		row = allocate( rowWords );
+		for( i = 0; i < coarseW; i++ )
+		{
+			index = j * ( coarseW + 1 ) + i;
+			if( !( passed[index] | passed[ index + 1 ]
+				| passed[ index + coarseW + 1 ] | passed[ index + coarseW + 2 ] ) )
+				continue;
+			end = ( i + 1 ) * step < width ? ( i + 1 ) * step : width;
+			for( x = i * step; x < end; x++ )
+				row[ x / CA_BITS_PER_WORD ] |= 1 << ( x % CA_BITS_PER_WORD );
+		}
+
+		end = ( j + 1 ) * step < height ? ( j + 1 ) * step : height;
+		for( y = j * step; y < end; y++ )
+			mask[ y * rowWords .. y * rowWords + rowWords - 1 ] = row;
+	}
+	return mask;
+}
+
+//--------------------------------------------------------------------------
+int SparseMaskCount( int *mask )
+{
+	int count = 0;
+	int word;
+
+	foreach( word in mask )
+		if( word )
+			count += CaPopcount( word );
+	return count;
+}
+
+//--------------------------------------------------------------------------
+int *SparseMaskIndices( int *mask, int width, int rows )
+{
+	int rowWords = CaRowWords( width );
+	int *indices = allocate( SparseMaskCount( mask ) );
+	int y, w, bits, x, next;
+
+	for( y = 0; y < rows; y++ )
+	{
+		for( w = 0; w < rowWords; w++ )
+		{
+			// Walk only the set bits of the word
+			bits = mask[ y * rowWords + w ];
+			for( x = w * CA_BITS_PER_WORD; bits; x++, bits >>= 1 )
+				if( bits & 1 )
+					indices[ next++ ] = y * width + x;
+		}
+	}
+	return indices;
+}
+
+//--------------------------------------------------------------------------
+mixed *Get2dFbmGridSparse( int originX, int originY, int width, int height, float scale, int octaves, int seed, int *mask )
+{
+	int rowWords = CaRowWords( width );
+	int *indices = SparseMaskIndices( mask, width, height );
+	float *values = allocate( sizeof( indices ), 0.0 );
+	float frequency = 1.0 / scale;
+	float *band, *dense;
+	int blockX, blockY, blockW, blockH, x, y, bits, selected, next;
+
+	for( blockY = 0; blockY < height; blockY += SPARSE_BLOCK )
+	{
+		blockH = height - blockY < SPARSE_BLOCK ? height - blockY : SPARSE_BLOCK;
+		band = allocate( width * blockH, 0.0 );
+
+		for( blockX = 0; blockX < width; blockX += SPARSE_BLOCK )
+		{
+			blockW = width - blockX < SPARSE_BLOCK ? width - blockX : SPARSE_BLOCK;
+			selected = 0;
+			for( y = 0; y < blockH; y++ )
+				selected += CaPopcount( sparse_block_bits( mask, rowWords, blockX, blockY + y, blockW ) );
+			if( !selected )
+				continue;
+
+			if( selected >= SPARSE_DENSE_FILL * blockW * blockH )
+			{
+				dense = Get2dFbmGrid( originX + blockX, originY + blockY, blockW, blockH, scale, octaves, seed );
+				for( y = 0; y < blockH; y++ )
+					band[ y * width + blockX .. y * width + blockX + blockW - 1 ] =
+						dense[ y * blockW .. y * blockW + blockW - 1 ];
+				continue;
+			}
+
+			for( y = 0; y < blockH; y++ )
+			{
+				bits = sparse_block_bits( mask, rowWords, blockX, blockY + y, blockW );
+				for( x = 0; bits; x++, bits >>= 1 )
+					if( bits & 1 )
+						band[ y * width + blockX + x ] = Get2dFbm( ( originX + blockX + x ) * frequency,
+							( originY + blockY + y ) * frequency, octaves, seed );
+			}
+		}
+
+		// Compact the band in row-major order, matching the indices
+		while( next < sizeof( indices ) && indices[next] < ( blockY + blockH ) * width )
+		{
+			values[next] = band[ indices[next] - blockY * width ];
+			next++;
+		}
+	}
+	return ({ indices, values });
+}
+
+//--------------------------------------------------------------------------
+mixed *Get3dFbmVolumeSparse( int originX, int originY, int originZ, int width, int height, int depth, float scale, int octaves, int seed, int *mask )
+{
+	int *indices = SparseMaskIndices( mask, width, height * depth );
+	float *values = allocate( sizeof( indices ), 0.0 );
+	float frequency = 1.0 / scale;
+	int i, row;
+
+	for( i = 0; i < sizeof( indices ); i++ )
+	{
+		row = indices[i] / width;
+		values[i] = Get3dFbm( ( originX + indices[i] % width ) * frequency,
+			( originY + row % height ) * frequency,
+			( originZ + row / height ) * frequency, octaves, seed );
+	}
+	return ({ indices, values });
+}
+
+#endif
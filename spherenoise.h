@@ -0,0 +1,220 @@
+// spherenoise.h
+// Planet-surface noise over cube-sphere face tiles
+// Built on noise.h (SquirrelNoise5), valuenoise.h (3D fBm) and tilecache.h
+
+#ifndef _SPHERENOISE_H
+#define _SPHERENOISE_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "tilecache.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Sphere noise
+//
+// A planet surface is sampled as 3D fBm at points on a sphere, which is
+//  seamless everywhere.  The surface is divided into the six faces of a
+//  cube projected onto the sphere, each face a resolution x resolution grid
+//  of cells, split into square tiles.  Unlike a latitude/longitude grid
+//  this has no poles where cells pinch together.
+//
+// Face coordinates (u, v) run from -1 to 1; cell (i, j) of a face has its
+//  center at u = 2 * (i + 0.5) / resolution - 1 (v likewise from j).  Cells
+//  use the equal-angle projection, where the cube point is
+//  (tan(u * pi/4), tan(v * pi/4)), which keeps cell areas within a factor
+//  of about 1.4 of each other across a face instead of the 5x spread of
+//  the plain projection.
+//
+// With a = tan(u * pi/4) and b = tan(v * pi/4), the faces are:
+//
+//  SPHERE_FACE_POS_X   ( 1,  b, -a)      SPHERE_FACE_NEG_X   (-1,  b,  a)
+//  SPHERE_FACE_POS_Y   ( a,  1, -b)      SPHERE_FACE_NEG_Y   ( a, -1,  b)
+//  SPHERE_FACE_POS_Z   ( a,  b,  1)      SPHERE_FACE_NEG_Z   (-a,  b, -1)
+//
+//  normalized to unit length.  The tangents only depend on the cell index,
+//  so they are computed once per resolution and cached; filling a tile
+//  then costs one square root per cell and no trigonometry.
+//
+// The sphere has the given radius in noise lattice units: fBm is sampled at
+//  direction * radius, so a larger radius gives more detail per cell.
+//  SphereFaceTile stores its tiles in the tile cache.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define SPHERE_FACE_POS_X       0
+#define SPHERE_FACE_NEG_X       1
+#define SPHERE_FACE_POS_Y       2
+#define SPHERE_FACE_NEG_Y       3
+#define SPHERE_FACE_POS_Z       4
+#define SPHERE_FACE_NEG_Z       5
+#define SPHERE_FACES            6
+
+#define SPHERE_QUARTER_PI       0.78539816339744830962
+
+//--------------------------------------------------------------------------
+// Directions.  SphereDirection returns the unit vector ({ x, y, z }) for
+//  face coordinates (u, v); SphereLocate returns ({ face, i, j }) of the
+//  cell containing a direction (which need not be normalized).
+//
+float *SphereDirection( int face, float posU, float posV );
+int *SphereLocate( float dirX, float dirY, float dirZ, int resolution );
+
+//--------------------------------------------------------------------------
+// Samples.  Latitude and longitude are in radians.
+//
+float GetSphereFbm( float dirX, float dirY, float dirZ, float radius, int octaves, int seed );
+float GetSphereFbmLatLon( float latitude, float longitude, float radius, int octaves, int seed );
+
+//--------------------------------------------------------------------------
+// Tile (tileX, tileY) of tileSize x tileSize cells on a face of the given
+//  resolution, row-major, through the tile cache.
+//
+float *SphereFaceTile( int face, int tileX, int tileY, int tileSize, int resolution, float radius, int octaves, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// resolution -> ({ tan per cell index })
+nosave private mapping sphere_tangents = ([]);
+
+//--------------------------------------------------------------------------
+private float *sphere_tangent_table( int resolution )
+{
+	float *table = sphere_tangents[resolution];
+	int i;
+
+	if( !table )
+	{
+		table = allocate( resolution, 0.0 );
+		for( i = 0; i < resolution; i++ )
+			table[i] = tan( ( 2.0 * ( i + 0.5 ) / resolution - 1.0 ) * SPHERE_QUARTER_PI );
+		sphere_tangents[resolution] = table;
+	}
+	return table;
+}
+
+//--------------------------------------------------------------------------
+// Cube point for face-plane coordinates (a, b), not normalized.
+//
+private float *sphere_cube_point( int face, float a, float b )
+{
+	switch( face )
+	{
+		case SPHERE_FACE_POS_X: return ({ 1.0, b, -a });
+		case SPHERE_FACE_NEG_X: return ({ -1.0, b, a });
+		case SPHERE_FACE_POS_Y: return ({ a, 1.0, -b });
+		case SPHERE_FACE_NEG_Y: return ({ a, -1.0, b });
+		case SPHERE_FACE_POS_Z: return ({ a, b, 1.0 });
+		case SPHERE_FACE_NEG_Z: return ({ -a, b, -1.0 });
+		default:
+			error( "Sphere: unknown face " + face + "\n" );
+	}
+}
+
+//--------------------------------------------------------------------------
+float *SphereDirection( int face, float posU, float posV )
+{
+	float a = tan( posU * SPHERE_QUARTER_PI );
+	float b = tan( posV * SPHERE_QUARTER_PI );
+	float *point = sphere_cube_point( face, a, b );
+	float scale = 1.0 / sqrt( 1.0 + a * a + b * b );
+
+	return ({ point[0] * scale, point[1] * scale, point[2] * scale });
+}
+
+//--------------------------------------------------------------------------
+int *SphereLocate( float dirX, float dirY, float dirZ, int resolution )
+{
+	float ax = abs( dirX );
+	float ay = abs( dirY );
+	float az = abs( dirZ );
+	float a, b;
+	int face, i, j;
+
+	// The major axis picks the face; dividing by it gives the cube point
+	if( ax >= ay && ax >= az )
+	{
+		face = dirX > 0.0 ? SPHERE_FACE_POS_X : SPHERE_FACE_NEG_X;
+		a = dirX > 0.0 ? -dirZ / ax : dirZ / ax;
+		b = dirY / ax;
+	}
+	else if( ay >= az )
+	{
+		face = dirY > 0.0 ? SPHERE_FACE_POS_Y : SPHERE_FACE_NEG_Y;
+		a = dirX / ay;
+		b = dirY > 0.0 ? -dirZ / ay : dirZ / ay;
+	}
+	else
+	{
+		face = dirZ > 0.0 ? SPHERE_FACE_POS_Z : SPHERE_FACE_NEG_Z;
+		a = dirZ > 0.0 ? dirX / az : -dirX / az;
+		b = dirY / az;
+	}
+
+	i = to_int( floor( ( atan( a ) / SPHERE_QUARTER_PI + 1.0 ) * 0.5 * resolution ) );
+	j = to_int( floor( ( atan( b ) / SPHERE_QUARTER_PI + 1.0 ) * 0.5 * resolution ) );
+	return ({ face, i < resolution ? i : resolution - 1, j < resolution ? j : resolution - 1 });
+}
+
+//--------------------------------------------------------------------------
+float GetSphereFbm( float dirX, float dirY, float dirZ, float radius, int octaves, int seed )
+{
+	float length = sqrt( dirX * dirX + dirY * dirY + dirZ * dirZ );
+	float scale = length > 0.0 ? radius / length : 0.0;
+
+	return Get3dFbm( dirX * scale, dirY * scale, dirZ * scale, octaves, seed );
+}
+
+//--------------------------------------------------------------------------
+float GetSphereFbmLatLon( float latitude, float longitude, float radius, int octaves, int seed )
+{
+	float ring = cos( latitude );
+
+	return Get3dFbm( radius * ring * cos( longitude ), radius * sin( latitude ),
+		radius * ring * sin( longitude ), octaves, seed );
+}
+
+//--------------------------------------------------------------------------
+private float *sphere_build_tile( int face, int tileX, int tileY, int tileSize, int resolution, float radius, int octaves, int seed )
+{
+	float *tangents = sphere_tangent_table( resolution );
+	float *tile = allocate( tileSize * tileSize, 0.0 );
+	float *point;
+	float a, b, scale;
+	int x, y, i, j;
+
+	for( y = 0; y < tileSize; y++ )
+	{
+		j = tileY * tileSize + y;
+		if( j >= resolution )
+			break;
+		b = tangents[j];
+		for( x = 0; x < tileSize; x++ )
+		{
+			i = tileX * tileSize + x;
+			if( i >= resolution )
+				break;
+			a = tangents[i];
+			point = sphere_cube_point( face, a, b );
+			scale = radius / sqrt( 1.0 + a * a + b * b );
+			tile[ y * tileSize + x ] = Get3dFbm( point[0] * scale, point[1] * scale,
+				point[2] * scale, octaves, seed );
+		}
+	}
+	return tile;
+}
+
+//--------------------------------------------------------------------------
+float *SphereFaceTile( int face, int tileX, int tileY, int tileSize, int resolution, float radius, int octaves, int seed )
+{
+	string key = TileCacheKey( sprintf( "sphere/%d/%d/%d/%s/%d", face, tileSize, resolution,
+		TileCacheEncodeFloat( radius ), octaves ),
+		tileX, tileY, seed );
+
+	return TileCacheFetch( key,
+		(: sphere_build_tile, face, tileX, tileY, tileSize, resolution, radius, octaves, seed :) );
+}
+
+#endif
@@ -0,0 +1,128 @@
+// temporal.h
+// Smooth 1D noise streams over time with incremental lattice updates
+// Built on noise.h (SquirrelNoise5) and valuenoise.h (1D value noise, fBm)
+
+#ifndef _TEMPORAL_H
+#define _TEMPORAL_H
+
+#include "noise.h"
+#include "valuenoise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Temporal streams
+//
+// NPC moods, market prices and tides follow smooth 1D noise over time, and
+//  are queried again and again at slowly increasing times.  Get1dFbm hashes
+//  two lattice values per octave on every call; a stream keeps the two
+//  lattice values around the last query for every octave instead:
+//
+//  - a query in the same lattice cell as the last one only interpolates;
+//  - moving forward into the next cell reuses the old upper value as the
+//    new lower one and hashes just one value;
+//  - any other jump (backwards, or more than a cell) rehashes both.
+//
+// Streams are arrays returned by TemporalStreamCreate and updated in place
+//  by sampling.  A stream with period p and n octaves returns exactly
+//  Get1dFbm( time / p, n, seed ); with one octave that is
+//  Get1dValueNoise( time / p, seed ).  Values are in [-1, 1].
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Stream layout
+#define TEMPORAL_PERIOD         0       // float
+#define TEMPORAL_OCTAVES        1       // int
+#define TEMPORAL_SEED           2       // int
+#define TEMPORAL_CELL           3       // int *: lattice cell per octave
+#define TEMPORAL_LOW            4       // float *: value at the cell, per octave
+#define TEMPORAL_HIGH           5       // float *: value at cell + 1, per octave
+
+//--------------------------------------------------------------------------
+// Create a stream.  period is the time between lattice points of the
+//  first octave, in the caller's time units.
+//
+mixed *TemporalStreamCreate( float period, int octaves, int seed );
+
+//--------------------------------------------------------------------------
+// Sample a stream at one time, or at count times start, start + interval,
+//  ... in one call.
+//
+float TemporalStreamSample( mixed *stream, float time );
+float *TemporalStreamRange( mixed *stream, float start, float interval, int count );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+mixed *TemporalStreamCreate( float period, int octaves, int seed )
+{
+	int *cells, octave;
+	float *low, *high;
+
+	if( octaves < 1 )
+		error( "TemporalStreamCreate: need at least one octave\n" );
+
+	cells = allocate( octaves );
+	low = allocate( octaves, 0.0 );
+	high = allocate( octaves, 0.0 );
+
+	// Prime every octave at cell 0
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		low[octave] = Get1dNoiseNegOneToOne( 0, seed + octave );
+		high[octave] = Get1dNoiseNegOneToOne( 1, seed + octave );
+	}
+	return ({ to_float( period ), octaves, seed, cells, low, high });
+}
+
+//--------------------------------------------------------------------------
+float TemporalStreamSample( mixed *stream, float time )
+{
+	int octaves = stream[TEMPORAL_OCTAVES];
+	int seed = stream[TEMPORAL_SEED];
+	int *cells = stream[TEMPORAL_CELL];
+	float *low = stream[TEMPORAL_LOW];
+	float *high = stream[TEMPORAL_HIGH];
+	float posX = time / stream[TEMPORAL_PERIOD];
+	float total = 0.0;
+	float amplitude = 1.0;
+	float range = 0.0;
+	int octave, cell;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		cell = to_int( floor( posX ) );
+		if( cell == cells[octave] + 1 )
+		{
+			low[octave] = high[octave];
+			high[octave] = Get1dNoiseNegOneToOne( cell + 1, seed + octave );
+			cells[octave] = cell;
+		}
+		else if( cell != cells[octave] )
+		{
+			low[octave] = Get1dNoiseNegOneToOne( cell, seed + octave );
+			high[octave] = Get1dNoiseNegOneToOne( cell + 1, seed + octave );
+			cells[octave] = cell;
+		}
+
+		total += amplitude * value_lerp( low[octave], high[octave], value_smoothstep( posX - cell ) );
+		range += amplitude;
+		posX *= FBM_LACUNARITY;
+		amplitude *= FBM_GAIN;
+	}
+	return total / range;
+}
+
+//--------------------------------------------------------------------------
+float *TemporalStreamRange( mixed *stream, float start, float interval, int count )
+{
+	float *samples = allocate( count, 0.0 );
+	int i;
+
+	for( i = 0; i < count; i++ )
+		samples[i] = TemporalStreamSample( stream, start + i * interval );
+	return samples;
+}
+
+#endif
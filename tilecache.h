@@ -0,0 +1,303 @@
+// tilecache.h
+// Bounded cache for generated tiles and other derived noise data
+// Built for use with noise.h (SquirrelNoise5) generators
+
+#ifndef _TILECACHE_H
+#define _TILECACHE_H
+
+#include "noise.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Tile cache
+//
+// Generated data is a pure function of its inputs, so anything expensive
+//  (heightmaps, flow fields, ...) can be kept around and regenerated on
+//  demand if it is ever dropped.  Entries are keyed by strings built with
+//  TileCacheKey from the noise algorithm ID, a kind, tile coordinates and
+//  seed, so different generators never collide, and tiles made by a
+//  different version of the noise functions are never returned.
+//
+// Float parameters in kinds must be written with TileCacheEncodeFloat, not
+//  %O or to_string: those round to a handful of digits, so two scales that
+//  differ below print precision would share (and serve each other's)
+//  tiles.  The encoding is the exact mantissa and binary exponent, e.g.
+//  "7205759403792794p-56" for 0.1, and TileCacheDecodeFloat reads it back
+//  bit for bit.
+//
+// The cache holds at most a fixed number of entries.  When it overflows,
+//  the least recently used quarter is evicted in one go, which keeps the
+//  bookkeeping cost per access at a mapping lookup and a counter bump.
+//
+// TileCacheSave writes the cache to a file, tagged with the algorithm ID
+//  that was running.  Every key carries the algorithm ID of the tiles it
+//  holds, so TileCacheRestore can load any file, old or new, without ever
+//  mixing versions up: entries made by an older algorithm come back under
+//  their own prefix, where only TileCacheKeyForAlgorithm with that ID finds
+//  them.  During a migration old and new tiles thus live side by side.
+//  TileCacheRestoreForAlgorithm loads just one algorithm's entries.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define TILE_CACHE_DEFAULT_CAPACITY     256
+
+//--------------------------------------------------------------------------
+// Keys and lookups.  TileCacheFetch returns the cached value, or calls
+//  generator() to make it, stores it and returns it.
+//
+string TileCacheKey( string kind, int tileX, int tileY, int seed );
+string TileCacheKeyForAlgorithm( string algorithm, string kind, int tileX, int tileY, int seed );
+mixed TileCacheGet( string key );
+void TileCacheSet( string key, mixed value );
+mixed TileCacheFetch( string key, function generator );
+
+//--------------------------------------------------------------------------
+// Lossless float text for keys and serialized data.  TileCacheDecodeFloat
+//  also accepts plain decimal text.
+//
+string TileCacheEncodeFloat( float value );
+float TileCacheDecodeFloat( string text );
+
+//--------------------------------------------------------------------------
+// Housekeeping.
+//
+void TileCacheRemove( string key );
+void TileCacheClear();
+void TileCacheSetCapacity( int capacity );
+mapping TileCacheStats();
+
+//--------------------------------------------------------------------------
+// Persistence.  All return 1 on success; the restores merge the entries
+//  into the cache.
+//
+int TileCacheSave( string path );
+int TileCacheRestore( string path );
+int TileCacheRestoreForAlgorithm( string path, string algorithm );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+// key -> ({ value, last use })
+nosave private mapping tile_cache = ([]);
+nosave private int tile_cache_capacity = TILE_CACHE_DEFAULT_CAPACITY;
+nosave private int tile_cache_clock;
+nosave private int tile_cache_hits;
+nosave private int tile_cache_misses;
+nosave private int tile_cache_evictions;
+nosave private string tile_cache_algorithm;
+
+//--------------------------------------------------------------------------
+string TileCacheKeyForAlgorithm( string algorithm, string kind, int tileX, int tileY, int seed )
+{
+	return sprintf( "%s:%s:%d:%d:%d", algorithm, kind, tileX, tileY, seed );
+}
+
+//--------------------------------------------------------------------------
+string TileCacheKey( string kind, int tileX, int tileY, int seed )
+{
+	if( !tile_cache_algorithm )
+		tile_cache_algorithm = NoiseAlgorithmId();
+	return TileCacheKeyForAlgorithm( tile_cache_algorithm, kind, tileX, tileY, seed );
+}
+
+//--------------------------------------------------------------------------
+string TileCacheEncodeFloat( float value )
+{
+	float magnitude = value < 0.0 ? -value : value;
+	int exponent = 0;
+	int mantissa;
+
+	if( value == 0.0 )
+		return "0";
+	if( value - value != 0.0 )
+		error( "TileCacheEncodeFloat: not a finite number\n" );
+
+	// Scale into [2^52, 2^53), where the mantissa is a whole number;
+	//  multiplying by powers of two is exact.  Coarse steps first, so huge
+	//  and tiny values do not take a thousand passes
+	while( magnitude >= 38685626227668133590597632.0 )     // 2^85
+	{
+		magnitude /= 4294967296.0;
+		exponent += 32;
+	}
+	while( magnitude < 1048576.0 )                          // 2^20
+	{
+		magnitude *= 4294967296.0;
+		exponent -= 32;
+	}
+	while( magnitude >= 9007199254740992.0 )                // 2^53
+	{
+		magnitude /= 2.0;
+		exponent++;
+	}
+	while( magnitude < 4503599627370496.0 )                 // 2^52
+	{
+		magnitude *= 2.0;
+		exponent--;
+	}
+
+	mantissa = to_int( magnitude );
+	return sprintf( "%dp%d", value < 0.0 ? -mantissa : mantissa, exponent );
+}
+
+//--------------------------------------------------------------------------
+float TileCacheDecodeFloat( string text )
+{
+	int mantissa, exponent;
+
+	if( sscanf( text, "%dp%d", mantissa, exponent ) != 2 )
+		return to_float( text );
+
+	// Two halves, so a subnormal result does not underflow 2^exponent
+	return mantissa * pow( 2.0, exponent / 2 ) * pow( 2.0, exponent - exponent / 2 );
+}
+
+//--------------------------------------------------------------------------
+// Drop the least recently used quarter of the cache.
+//
+private void tile_cache_evict()
+{
+	string *cached = keys( tile_cache );
+	int *uses = allocate( sizeof( cached ) );
+	int cutoff, i;
+
+	for( i = 0; i < sizeof( cached ); i++ )
+		uses[i] = tile_cache[ cached[i] ][1];
+	uses = sort_array( uses, 1 );
+	cutoff = uses[ sizeof( uses ) / 4 ];
+
+	for( i = 0; i < sizeof( cached ); i++ )
+	{
+		if( tile_cache[ cached[i] ][1] <= cutoff )
+		{
+			map_delete( tile_cache, cached[i] );
+			tile_cache_evictions++;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+mixed TileCacheGet( string key )
+{
+	mixed *entry = tile_cache[key];
+
+	if( !entry )
+	{
+		tile_cache_misses++;
+		return 0;
+	}
+	tile_cache_hits++;
+	entry[1] = ++tile_cache_clock;
+	return entry[0];
+}
+
+//--------------------------------------------------------------------------
+void TileCacheSet( string key, mixed value )
+{
+	tile_cache[key] = ({ value, ++tile_cache_clock });
+	if( sizeof( tile_cache ) > tile_cache_capacity )
+		tile_cache_evict();
+}
+
+//--------------------------------------------------------------------------
+mixed TileCacheFetch( string key, function generator )
+{
+	mixed value = TileCacheGet( key );
+
+	if( undefinedp( tile_cache[key] ) )
+	{
+		value = evaluate( generator );
+		TileCacheSet( key, value );
+	}
+	return value;
+}
+
+//--------------------------------------------------------------------------
+void TileCacheRemove( string key )
+{
+	map_delete( tile_cache, key );
+}
+
+//--------------------------------------------------------------------------
+void TileCacheClear()
+{
+	tile_cache = ([]);
+}
+
+//--------------------------------------------------------------------------
+void TileCacheSetCapacity( int capacity )
+{
+	tile_cache_capacity = capacity > 1 ? capacity : 1;
+	while( sizeof( tile_cache ) > tile_cache_capacity )
+		tile_cache_evict();
+}
+
+//--------------------------------------------------------------------------
+mapping TileCacheStats()
+{
+	return ([
+		"entries" : sizeof( tile_cache ),
+		"capacity" : tile_cache_capacity,
+		"hits" : tile_cache_hits,
+		"misses" : tile_cache_misses,
+		"evictions" : tile_cache_evictions,
+	]);
+}
+
+//--------------------------------------------------------------------------
+int TileCacheSave( string path )
+{
+	mapping entries = ([]);
+	string key;
+
+	foreach( key in keys( tile_cache ) )
+		entries[key] = tile_cache[key][0];
+	return write_file( path, save_variable( ({ NoiseAlgorithmId(), entries }) ), 1 );
+}
+
+//--------------------------------------------------------------------------
+// Entries saved in a file, or 0 if it is not a tile cache file.
+//
+private mapping tile_cache_read( string path )
+{
+	string text = read_file( path );
+	mixed saved;
+
+	if( !text )
+		return 0;
+	saved = restore_variable( text );
+	if( !arrayp( saved ) || sizeof( saved ) != 2 || !stringp( saved[0] ) || !mapp( saved[1] ) )
+		return 0;
+	return saved[1];
+}
+
+//--------------------------------------------------------------------------
+int TileCacheRestore( string path )
+{
+	mapping entries = tile_cache_read( path );
+	string key;
+
+	if( !entries )
+		return 0;
+	foreach( key in keys( entries ) )
+		TileCacheSet( key, entries[key] );
+	return 1;
+}
+
+//--------------------------------------------------------------------------
+int TileCacheRestoreForAlgorithm( string path, string algorithm )
+{
+	mapping entries = tile_cache_read( path );
+	string prefix = algorithm + ":";
+	string key;
+
+	if( !entries )
+		return 0;
+	foreach( key in keys( entries ) )
+		if( strsrch( key, prefix ) == 0 )
+			TileCacheSet( key, entries[key] );
+	return 1;
+}
+
+#endif
@@ -0,0 +1,306 @@
+// valuenoise.h
+// Smoothed value noise and fractal (fBm) noise
+// Built on noise.h (SquirrelNoise5) and noisebackend.h
+
+#ifndef _VALUENOISE_H
+#define _VALUENOISE_H
+
+#include "noise.h"
+#include "noisebackend.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Value noise
+//
+// Lattice points take their value from Get*dNoiseNegOneToOne, and positions
+//  between lattice points are blended with a smoothstep curve.  Results are
+//  in [-1,1].  Fractal (fBm) noise sums octaves at doubling frequency and
+//  halving amplitude, each octave with its own seed, and is normalized back
+//  to [-1,1].
+//
+// The grid forms hash each lattice point once per octave and reuse it for
+//  every sample that falls in its cells, which is much cheaper than calling
+//  the point functions per sample when the scale is larger than one cell.
+//  Grid results are row-major: index = y * width + x.
+//
+// The GetBackend* forms hash their lattice points with a noisebackend.h
+//  backend instead.  The plain forms are the NOISE_BACKEND_SQUIRREL5 case
+//  and give exactly the same values as before.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define FBM_LACUNARITY          2.0
+#define FBM_GAIN                0.5
+
+//--------------------------------------------------------------------------
+// Single samples.
+//
+float Get1dValueNoise( float posX, int seed );
+float Get2dValueNoise( float posX, float posY, int seed );
+float Get3dValueNoise( float posX, float posY, float posZ, int seed );
+
+float Get1dFbm( float posX, int octaves, int seed );
+float Get2dFbm( float posX, float posY, int octaves, int seed );
+float Get3dFbm( float posX, float posY, float posZ, int octaves, int seed );
+
+//--------------------------------------------------------------------------
+// Grid of fBm samples at world cells (originX + x, originY + y), each
+//  sampled at (cell / scale).
+//
+float *Get2dFbmGrid( int originX, int originY, int width, int height, float scale, int octaves, int seed );
+
+//--------------------------------------------------------------------------
+// The same, with lattice points hashed by a chosen backend.
+//
+float GetBackend1dValueNoise( int backend, float posX, int seed );
+float GetBackend2dValueNoise( int backend, float posX, float posY, int seed );
+float GetBackend3dValueNoise( int backend, float posX, float posY, float posZ, int seed );
+
+float GetBackend1dFbm( int backend, float posX, int octaves, int seed );
+float GetBackend2dFbm( int backend, float posX, float posY, int octaves, int seed );
+float GetBackend3dFbm( int backend, float posX, float posY, float posZ, int octaves, int seed );
+
+float *GetBackend2dFbmGrid( int backend, int originX, int originY, int width, int height, float scale, int octaves, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private float value_smoothstep( float t )
+{
+	return t * t * ( 3.0 - 2.0 * t );
+}
+
+//--------------------------------------------------------------------------
+private float value_lerp( float a, float b, float t )
+{
+	return a + ( b - a ) * t;
+}
+
+//--------------------------------------------------------------------------
+// A 32-bit hash mapped to [-1, 1] the way Get*dNoiseNegOneToOne does.
+//
+private float value_signed( int bits )
+{
+	return ( 1.0 * ( bits - INT_32_SIGNED_MAX ) ) / INT_32_SIGNED_MAX;
+}
+
+//--------------------------------------------------------------------------
+float GetBackend1dValueNoise( int backend, float posX, int seed )
+{
+	int x0 = to_int( floor( posX ) );
+	float tx = value_smoothstep( posX - x0 );
+
+	return value_lerp( value_signed( GetBackend1dNoise( backend, x0, seed ) ),
+		value_signed( GetBackend1dNoise( backend, x0 + 1, seed ) ), tx );
+}
+
+//--------------------------------------------------------------------------
+float GetBackend2dValueNoise( int backend, float posX, float posY, int seed )
+{
+	int x0 = to_int( floor( posX ) );
+	int y0 = to_int( floor( posY ) );
+	float tx = value_smoothstep( posX - x0 );
+	float ty = value_smoothstep( posY - y0 );
+	float top, bottom;
+
+	top = value_lerp( value_signed( GetBackend2dNoise( backend, x0, y0, seed ) ),
+		value_signed( GetBackend2dNoise( backend, x0 + 1, y0, seed ) ), tx );
+	bottom = value_lerp( value_signed( GetBackend2dNoise( backend, x0, y0 + 1, seed ) ),
+		value_signed( GetBackend2dNoise( backend, x0 + 1, y0 + 1, seed ) ), tx );
+	return value_lerp( top, bottom, ty );
+}
+
+//--------------------------------------------------------------------------
+float GetBackend3dValueNoise( int backend, float posX, float posY, float posZ, int seed )
+{
+	int x0 = to_int( floor( posX ) );
+	int y0 = to_int( floor( posY ) );
+	int z0 = to_int( floor( posZ ) );
+	float tx = value_smoothstep( posX - x0 );
+	float ty = value_smoothstep( posY - y0 );
+	float tz = value_smoothstep( posZ - z0 );
+	float near, far;
+
+	near = value_lerp(
+		value_lerp( value_signed( GetBackend3dNoise( backend, x0, y0, z0, seed ) ),
+			value_signed( GetBackend3dNoise( backend, x0 + 1, y0, z0, seed ) ), tx ),
+		value_lerp( value_signed( GetBackend3dNoise( backend, x0, y0 + 1, z0, seed ) ),
+			value_signed( GetBackend3dNoise( backend, x0 + 1, y0 + 1, z0, seed ) ), tx ),
+		ty );
+	far = value_lerp(
+		value_lerp( value_signed( GetBackend3dNoise( backend, x0, y0, z0 + 1, seed ) ),
+			value_signed( GetBackend3dNoise( backend, x0 + 1, y0, z0 + 1, seed ) ), tx ),
+		value_lerp( value_signed( GetBackend3dNoise( backend, x0, y0 + 1, z0 + 1, seed ) ),
+			value_signed( GetBackend3dNoise( backend, x0 + 1, y0 + 1, z0 + 1, seed ) ), tx ),
+		ty );
+	return value_lerp( near, far, tz );
+}
+
+//--------------------------------------------------------------------------
+float GetBackend1dFbm( int backend, float posX, int octaves, int seed )
+{
+	float total = 0.0;
+	float amplitude = 1.0;
+	float range = 0.0;
+	int octave;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		total += amplitude * GetBackend1dValueNoise( backend, posX, seed + octave );
+		range += amplitude;
+		posX *= FBM_LACUNARITY;
+		amplitude *= FBM_GAIN;
+	}
+	return range > 0.0 ? total / range : 0.0;
+}
+
+//--------------------------------------------------------------------------
+float GetBackend2dFbm( int backend, float posX, float posY, int octaves, int seed )
+{
+	float total = 0.0;
+	float amplitude = 1.0;
+	float range = 0.0;
+	int octave;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		total += amplitude * GetBackend2dValueNoise( backend, posX, posY, seed + octave );
+		range += amplitude;
+		posX *= FBM_LACUNARITY;
+		posY *= FBM_LACUNARITY;
+		amplitude *= FBM_GAIN;
+	}
+	return range > 0.0 ? total / range : 0.0;
+}
+
+//--------------------------------------------------------------------------
+float GetBackend3dFbm( int backend, float posX, float posY, float posZ, int octaves, int seed )
+{
+	float total = 0.0;
+	float amplitude = 1.0;
+	float range = 0.0;
+	int octave;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		total += amplitude * GetBackend3dValueNoise( backend, posX, posY, posZ, seed + octave );
+		range += amplitude;
+		posX *= FBM_LACUNARITY;
+		posY *= FBM_LACUNARITY;
+		posZ *= FBM_LACUNARITY;
+		amplitude *= FBM_GAIN;
+	}
+	return range > 0.0 ? total / range : 0.0;
+}
+
+//--------------------------------------------------------------------------
+float *GetBackend2dFbmGrid( int backend, int originX, int originY, int width, int height, float scale, int octaves, int seed )
+{
+	float *grid = allocate( width * height, 0.0 );
+	float frequency = 1.0 / scale;
+	float amplitude = 1.0;
+	float range = 0.0;
+	float *lattice, *tx;
+	int *cellX, *hashes;
+	int octave, x, y, i, row;
+	int latX0, latY0, latW, latH, cellY;
+	float fx, fy, ty, top, bottom;
+
+	for( octave = 0; octave < octaves; octave++ )
+	{
+		// Lattice rectangle covering the grid at this octave's frequency,
+		//  hashed a row at a time
+		latX0 = to_int( floor( originX * frequency ) );
+		latY0 = to_int( floor( originY * frequency ) );
+		latW = to_int( floor( ( originX + width - 1 ) * frequency ) ) - latX0 + 2;
+		latH = to_int( floor( ( originY + height - 1 ) * frequency ) ) - latY0 + 2;
+		lattice = allocate( latW * latH, 0.0 );
+		for( y = 0; y < latH; y++ )
+		{
+			hashes = GetBackend2dNoiseRow( backend, latX0, latY0 + y, latW, seed + octave );
+			for( x = 0; x < latW; x++ )
+				lattice[ y * latW + x ] = value_signed( hashes[x] );
+		}
+
+		// Column offsets and weights are the same for every row
+		cellX = allocate( width );
+		tx = allocate( width, 0.0 );
+		for( x = 0; x < width; x++ )
+		{
+			fx = ( originX + x ) * frequency;
+			cellX[x] = to_int( floor( fx ) );
+			tx[x] = value_smoothstep( fx - cellX[x] );
+			cellX[x] -= latX0;
+		}
+
+		for( y = 0; y < height; y++ )
+		{
+			fy = ( originY + y ) * frequency;
+			cellY = to_int( floor( fy ) );
+			ty = value_smoothstep( fy - cellY );
+			row = ( cellY - latY0 ) * latW;
+			for( x = 0; x < width; x++ )
+			{
+				i = row + cellX[x];
+				top = value_lerp( lattice[i], lattice[i + 1], tx[x] );
+				bottom = value_lerp( lattice[i + latW], lattice[i + latW + 1], tx[x] );
+				grid[ y * width + x ] += amplitude * value_lerp( top, bottom, ty );
+			}
+		}
+
+		range += amplitude;
+		frequency *= FBM_LACUNARITY;
+		amplitude *= FBM_GAIN;
+	}
+
+	if( range > 0.0 )
+		for( i = 0; i < width * height; i++ )
+			grid[i] /= range;
+	return grid;
+}
+
+//--------------------------------------------------------------------------
+float Get1dValueNoise( float posX, int seed )
+{
+	return GetBackend1dValueNoise( NOISE_BACKEND_SQUIRREL5, posX, seed );
+}
+
+//--------------------------------------------------------------------------
+float Get2dValueNoise( float posX, float posY, int seed )
+{
+	return GetBackend2dValueNoise( NOISE_BACKEND_SQUIRREL5, posX, posY, seed );
+}
+
+//--------------------------------------------------------------------------
+float Get3dValueNoise( float posX, float posY, float posZ, int seed )
+{
+	return GetBackend3dValueNoise( NOISE_BACKEND_SQUIRREL5, posX, posY, posZ, seed );
+}
+
+//--------------------------------------------------------------------------
+float Get1dFbm( float posX, int octaves, int seed )
+{
+	return GetBackend1dFbm( NOISE_BACKEND_SQUIRREL5, posX, octaves, seed );
+}
+
+//--------------------------------------------------------------------------
+float Get2dFbm( float posX, float posY, int octaves, int seed )
+{
+	return GetBackend2dFbm( NOISE_BACKEND_SQUIRREL5, posX, posY, octaves, seed );
+}
+
+//--------------------------------------------------------------------------
+float Get3dFbm( float posX, float posY, float posZ, int octaves, int seed )
+{
+	return GetBackend3dFbm( NOISE_BACKEND_SQUIRREL5, posX, posY, posZ, octaves, seed );
+}
+
+//--------------------------------------------------------------------------
+float *Get2dFbmGrid( int originX, int originY, int width, int height, float scale, int octaves, int seed )
+{
+	return GetBackend2dFbmGrid( NOISE_BACKEND_SQUIRREL5, originX, originY, width, height, scale, octaves, seed );
+}
+
+#endif
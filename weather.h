@@ -0,0 +1,150 @@
+// weather.h
+// Room weather interpolated from cached coarse noise keyframes
+// Built on noise.h (SquirrelNoise5), valuenoise.h (3D fBm) and tilecache.h
+
+#ifndef _WEATHER_H
+#define _WEATHER_H
+
+#include "noise.h"
+#include "valuenoise.h"
+#include "tilecache.h"
+
+////////////////////////////////////////////////////////////////////////////
+// Weather
+//
+// Weather is a set of channels (temperature, precipitation, wind), each a
+//  3D fBm field over (x, y, time).  Rather than hashing that field for every
+//  room on every query, it is sampled on a coarse lattice: one point every
+//  WEATHER_CELL_SIZE world units, at one time step every WEATHER_STEP
+//  seconds.  A keyframe holds the lattice for one WEATHER_REGION_CELLS
+//  square region at one time step, all channels, and is built on first use.
+//
+// A room query finds the keyframes for the current and the next time step
+//  and interpolates: bilinearly between the four lattice points around the
+//  room, then smoothly between the two steps.  Lattice points on a region
+//  edge are shared with the neighboring region, so the weather is seamless
+//  across regions, and it drifts continuously between steps.
+//
+// Keyframes are stored in the tile cache, keyed by region, step and seed.
+//  Keyframes from past steps are no longer asked for once the clock moves
+//  on, so they age out of it like any other unused tile.  A busy area
+//  therefore costs a handful of keyframes, and each query after the first
+//  is pure interpolation.
+//
+// Channel values are in [-1, 1]; map them to degrees, millimeters or
+//  descriptions as the area needs.  Each channel has its own seed derived
+//  from the caller's seed, so the channels are independent.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define WEATHER_TEMPERATURE     0
+#define WEATHER_PRECIPITATION   1
+#define WEATHER_WIND            2
+#define WEATHER_CHANNELS        3
+
+#define WEATHER_STEP            600     // Seconds between keyframes
+#define WEATHER_CELL_SIZE       16      // World units between lattice points
+#define WEATHER_REGION_CELLS    16      // Lattice cells per keyframe side
+#define WEATHER_SCALE           8.0     // Lattice cells per fBm unit
+#define WEATHER_DRIFT           0.25    // fBm units the field moves per step
+#define WEATHER_OCTAVES         3
+
+//--------------------------------------------------------------------------
+// Weather at a world position.  time is in seconds, e.g. time().
+//  WeatherAt returns all channels, indexed by WEATHER_*.
+//
+float *WeatherAt( int posX, int posY, int time, int seed );
+float WeatherChannel( int channel, int posX, int posY, int time, int seed );
+
+
+////////////////////////////////////////////////////////////////////////////
+// Function definitions below
+////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------
+private mixed *weather_build_keyframe( int regionX, int regionY, int step, int seed )
+{
+	int side = WEATHER_REGION_CELLS + 1;
+	mixed *frame = allocate( WEATHER_CHANNELS );
+	float *lattice;
+	float posT = step * WEATHER_DRIFT;
+	int channel, channelSeed, i, j;
+
+	for( channel = 0; channel < WEATHER_CHANNELS; channel++ )
+	{
+		channelSeed = Get1dNoise( channel, seed );
+		lattice = allocate( side * side, 0.0 );
+		for( j = 0; j < side; j++ )
+			for( i = 0; i < side; i++ )
+				lattice[ j * side + i ] = Get3dFbm(
+					( regionX * WEATHER_REGION_CELLS + i ) / WEATHER_SCALE,
+					( regionY * WEATHER_REGION_CELLS + j ) / WEATHER_SCALE,
+					posT, WEATHER_OCTAVES, channelSeed );
+		frame[channel] = lattice;
+	}
+	return frame;
+}
+
+//--------------------------------------------------------------------------
+// Keyframe for one region at one step.  The region size and octave count
+//  are part of the key, so changing either never serves keyframes of the
+//  old shape.
+//
+private mixed *weather_keyframe( int regionX, int regionY, int step, int seed )
+{
+	string key = TileCacheKey( sprintf( "weather/%d/%d/%d", WEATHER_REGION_CELLS, WEATHER_OCTAVES, step ),
+		regionX, regionY, seed );
+
+	return TileCacheFetch( key, (: weather_build_keyframe, regionX, regionY, step, seed :) );
+}
+
+//--------------------------------------------------------------------------
+float *WeatherAt( int posX, int posY, int time, int seed )
+{
+	int side = WEATHER_REGION_CELLS + 1;
+	float cellX = posX / ( 1.0 * WEATHER_CELL_SIZE );
+	float cellY = posY / ( 1.0 * WEATHER_CELL_SIZE );
+	float steps = time / ( 1.0 * WEATHER_STEP );
+	int latticeX = to_int( floor( cellX ) );
+	int latticeY = to_int( floor( cellY ) );
+	int step = to_int( floor( steps ) );
+	int regionX = to_int( floor( latticeX / ( 1.0 * WEATHER_REGION_CELLS ) ) );
+	int regionY = to_int( floor( latticeY / ( 1.0 * WEATHER_REGION_CELLS ) ) );
+	int corner = ( latticeY - regionY * WEATHER_REGION_CELLS ) * side
+		+ latticeX - regionX * WEATHER_REGION_CELLS;
+	float tx = value_smoothstep( cellX - latticeX );
+	float ty = value_smoothstep( cellY - latticeY );
+	float tt = value_smoothstep( steps - step );
+	float *result = allocate( WEATHER_CHANNELS, 0.0 );
+	mixed *now, *next;
+	float *a, *b;
+	float top, bottom, valueNow, valueNext;
+	int channel;
+
+	now = weather_keyframe( regionX, regionY, step, seed );
+	next = weather_keyframe( regionX, regionY, step + 1, seed );
+
+	for( channel = 0; channel < WEATHER_CHANNELS; channel++ )
+	{
+		a = now[channel];
+		top = value_lerp( a[corner], a[ corner + 1 ], tx );
+		bottom = value_lerp( a[ corner + side ], a[ corner + side + 1 ], tx );
+		valueNow = value_lerp( top, bottom, ty );
+
+		b = next[channel];
+		top = value_lerp( b[corner], b[ corner + 1 ], tx );
+		bottom = value_lerp( b[ corner + side ], b[ corner + side + 1 ], tx );
+		valueNext = value_lerp( top, bottom, ty );
+
+		result[channel] = value_lerp( valueNow, valueNext, tt );
+	}
+	return result;
+}
+
+//--------------------------------------------------------------------------
+float WeatherChannel( int channel, int posX, int posY, int time, int seed )
+{
+	return WeatherAt( posX, posY, time, seed )[channel];
+}
+
+#endif